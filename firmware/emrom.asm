@@ -1,5 +1,20 @@
 	.EQU size, 0x20
+	.EQU mode, 0x21
+	.EQU select, 0x22
 	.EQU buffer, 0x3E
+	.EQU crc, 0x42
+
+	.EQU PROTOCOL, 0x03
+	.EQU COMMANDS, 0xFF
+	.EQU FRAME, 0x40
+	.EQU MEMORY_LOW, 0x00
+	.EQU MEMORY_HIGH, 0x01
+	.EQU QUEUE, 0x01
+	.EQU FEATURES, 0x01
+	.EQU CRC_TABLE, 0x0C
+	.EQU BOARD, 0x00
+	.EQU UNSELECTED, 0x00
+	.EQU BROADCAST, 0xFF
 
 	.FLAG LE0, P3.2
 	.FLAG LE1, P3.3
@@ -18,15 +33,56 @@ entry:
 	mov SCON, #0x52
 
 loop:
-	clr LE0
-	setb LE1
-	clr AEN
-	clr MRD
-	setb MWR
-	mov P0, #0xFF
-	mov P1, #0xFF
-	mov P2, #0xFF
+	acall release
 	acall recv
+	mov A, select
+	cjne A, #BOARD, loop_select
+	sjmp loop_mode
+
+loop_select:
+	cjne A, #BROADCAST, loop
+
+loop_mode:
+	mov A, mode
+	cjne A, #'?', loop_blank
+	ajmp identify
+
+loop_blank:
+	cjne A, #'=', loop_crc
+	ajmp blank
+
+loop_crc:
+	cjne A, #'%', loop_sample
+	ajmp crc_check
+
+loop_sample:
+	cjne A, #'&', loop_fill
+	ajmp sample
+
+loop_fill:
+	cjne A, #'#', memory
+	ajmp fill
+
+identify:
+	mov buffer, #PROTOCOL
+	mov buffer + 1, #FRAME
+	mov buffer + 2, #COMMANDS
+	mov buffer + 3, #MEMORY_LOW
+	mov buffer + 4, #MEMORY_HIGH
+	mov buffer + 5, #QUEUE
+	mov buffer + 6, #FEATURES
+	mov size, #0x07
+	acall send
+	ajmp loop
+
+memory:
+	mov A, mode
+	cjne A, #';', memory_size
+	mov A, size
+	cjne A, #0x02, memory_size
+	ajmp loop
+
+memory_size:
 	mov A, size
 	
 read:
@@ -51,12 +107,13 @@ read_data:
 	inc R0
 	inc DPTR
 	djnz R1, read_data
+	acall release
 	mov size, #0x42
 	acall send
 	ajmp loop
 	
 write:
-	cjne A, #0x42, loop
+	jc loop
 	setb LE0
 	clr LE1
 	setb AEN
@@ -65,7 +122,13 @@ write:
 	mov DPL, buffer
 	mov DPH, buffer + 1
 	mov R0, #(buffer + 2)
-	mov R1, #0x40
+	add A, #(-2)
+	mov R1, A
+	mov R6, buffer
+	mov R7, buffer + 1
+	mov A, mode
+	cjne A, #';', write_data
+	sjmp write_check
 
 write_data:
 	mov P1, DPL
@@ -78,19 +141,275 @@ write_data:
 	inc R0
 	inc DPTR
 	djnz R1, write_data
+
+write_done:
+	acall release
+	mov buffer, R6
+	mov buffer + 1, R7
 	mov size, #0x02
 	acall send
 	ajmp loop
 
+write_check:
+	mov P1, DPL
+	mov P2, DPH
+	mov P0, @R0
+	nop
+	clr MWR
+	nop
+	setb MWR
+	mov P0, #0xFF
+	clr MRD
+	nop
+	mov A, P0
+	setb MRD
+	add A, R6
+	mov R6, A
+	add A, R7
+	mov R7, A
+	inc R0
+	inc DPTR
+	djnz R1, write_check
+	sjmp write_done
+
+;-------------------------------
+
+blank:
+	mov A, size
+	cjne A, #0x05, blank_skip
+	acall scan
+
+blank_data:
+	mov P1, R2
+	mov P2, R3
+	clr MRD
+	nop
+	mov A, P0
+	setb MRD
+	cjne A, buffer + 4, blank_fail
+	inc R2
+	cjne R2, #0x00, blank_next
+	inc R3
+
+blank_next:
+	djnz R4, blank_data
+	djnz R5, blank_data
+	mov buffer, #0x00
+	sjmp blank_done
+
+blank_fail:
+	mov buffer, #0x01
+
+blank_done:
+	acall release
+	mov buffer + 1, R2
+	mov buffer + 2, R3
+	mov size, #0x03
+	acall send
+
+blank_skip:
+	ajmp loop
+
+;-------------------------------
+
+crc_check:
+	mov A, size
+	cjne A, #0x08, crc_skip
+	acall scan
+	mov DPL, #0x00
+
+crc_data:
+	mov P1, R2
+	mov P2, R3
+	clr MRD
+	nop
+	mov A, P0
+	setb MRD
+	xrl A, crc
+	mov R7, A
+	mov DPH, #CRC_TABLE
+	movc A, @A+DPTR
+	xrl A, crc + 1
+	mov crc, A
+	mov A, R7
+	mov DPH, #(CRC_TABLE + 1)
+	movc A, @A+DPTR
+	xrl A, crc + 2
+	mov crc + 1, A
+	mov A, R7
+	mov DPH, #(CRC_TABLE + 2)
+	movc A, @A+DPTR
+	xrl A, crc + 3
+	mov crc + 2, A
+	mov A, R7
+	mov DPH, #(CRC_TABLE + 3)
+	movc A, @A+DPTR
+	mov crc + 3, A
+	inc R2
+	cjne R2, #0x00, crc_next
+	inc R3
+
+crc_next:
+	djnz R4, crc_data
+	djnz R5, crc_data
+	acall release
+	mov buffer, crc
+	mov buffer + 1, crc + 1
+	mov buffer + 2, crc + 2
+	mov buffer + 3, crc + 3
+	mov size, #0x04
+	acall send
+
+crc_skip:
+	ajmp loop
+
+;-------------------------------
+
+fill:
+	mov A, size
+	cjne A, #0x05, fill_skip
+	acall scan
+	mov P0, buffer + 4
+
+fill_data:
+	mov P1, R2
+	mov P2, R3
+	clr MWR
+	nop
+	setb MWR
+	inc R2
+	cjne R2, #0x00, fill_next
+	inc R3
+
+fill_next:
+	djnz R4, fill_data
+	djnz R5, fill_data
+	acall release
+	mov buffer, R2
+	mov buffer + 1, R3
+	mov size, #0x02
+	acall send
+
+fill_skip:
+	ajmp loop
+
+;-------------------------------
+
+sample:
+	mov A, size
+	cjne A, #0x03, sample_skip
+	mov A, buffer + 2
+	jz sample_skip
+	cjne A, #(FRAME + 1), sample_size
+
+sample_size:
+	jnc sample_skip
+	mov R1, A
+	mov size, A
+	mov DPL, buffer
+	mov DPH, buffer + 1
+	mov R0, #buffer
+	acall scan_bus
+
+sample_data:
+	mov P1, DPL
+	mov P2, DPH
+	clr MRD
+	nop
+	mov @R0, P0
+	setb MRD
+	inc R0
+	inc DPTR
+	djnz R1, sample_data
+	acall release
+	acall send
+
+sample_skip:
+	ajmp loop
+
+;-------------------------------
+
+scan:
+	mov R2, buffer
+	mov R3, buffer + 1
+	mov R4, buffer + 2
+	mov R5, buffer + 3
+	cjne R4, #0x00, scan_round
+	sjmp scan_bus
+
+scan_round:
+	inc R5
+
+scan_bus:
+	setb LE0
+	clr LE1
+	setb AEN
+	setb MRD
+	setb MWR
+	ret
+
+;-------------------------------
+
+release:
+	clr AEN
+	clr LE0
+	setb LE1
+	clr MRD
+	setb MWR
+	mov P0, #0xFF
+	mov P1, #0xFF
+	mov P2, #0xFF
+	ret
+
 ;-------------------------------
 
 recv:
 	mov R0, #buffer
 	mov R1, #0
+	mov select, #UNSELECTED
 
 recv_head:
 	acall get
-	cjne A, #':', recv_head
+	mov mode, A
+	cjne A, #'@', recv_head_write
+	acall get
+	acall decode
+	jc recv
+	swap A
+	mov select, A
+	acall get
+	acall decode
+	jc recv
+	orl A, select
+	mov select, A
+	sjmp recv_head
+
+recv_head_write:
+	cjne A, #':', recv_head_identify
+	ajmp recv_data
+
+recv_head_identify:
+	cjne A, #'?', recv_head_blank
+	ajmp recv_data
+
+recv_head_blank:
+	cjne A, #'=', recv_head_crc
+	ajmp recv_data
+
+recv_head_crc:
+	cjne A, #'%', recv_head_check
+	ajmp recv_data
+
+recv_head_check:
+	cjne A, #';', recv_head_sample
+	ajmp recv_data
+
+recv_head_sample:
+	cjne A, #'&', recv_head_fill
+	ajmp recv_data
+
+recv_head_fill:
+	cjne A, #'#', recv_head
 
 recv_data:
 	acall get
@@ -155,6 +474,11 @@ decode_A_to_F:
 ;-------------------------------
 
 send:
+	mov A, select
+	cjne A, #BROADCAST, send_frame
+	ret
+
+send_frame:
 	mov R0, #buffer
 	mov R1, size
 
@@ -219,5 +543,142 @@ put:
 	mov SBUF, A
 	ret
 
+;-------------------------------
+
+	.ORG 0x0C00
+
+crc_table:
+	.DB 0x00, 0x96, 0x2C, 0xBA, 0x19, 0x8F, 0x35, 0xA3
+	.DB 0x32, 0xA4, 0x1E, 0x88, 0x2B, 0xBD, 0x07, 0x91
+	.DB 0x64, 0xF2, 0x48, 0xDE, 0x7D, 0xEB, 0x51, 0xC7
+	.DB 0x56, 0xC0, 0x7A, 0xEC, 0x4F, 0xD9, 0x63, 0xF5
+	.DB 0xC8, 0x5E, 0xE4, 0x72, 0xD1, 0x47, 0xFD, 0x6B
+	.DB 0xFA, 0x6C, 0xD6, 0x40, 0xE3, 0x75, 0xCF, 0x59
+	.DB 0xAC, 0x3A, 0x80, 0x16, 0xB5, 0x23, 0x99, 0x0F
+	.DB 0x9E, 0x08, 0xB2, 0x24, 0x87, 0x11, 0xAB, 0x3D
+	.DB 0x90, 0x06, 0xBC, 0x2A, 0x89, 0x1F, 0xA5, 0x33
+	.DB 0xA2, 0x34, 0x8E, 0x18, 0xBB, 0x2D, 0x97, 0x01
+	.DB 0xF4, 0x62, 0xD8, 0x4E, 0xED, 0x7B, 0xC1, 0x57
+	.DB 0xC6, 0x50, 0xEA, 0x7C, 0xDF, 0x49, 0xF3, 0x65
+	.DB 0x58, 0xCE, 0x74, 0xE2, 0x41, 0xD7, 0x6D, 0xFB
+	.DB 0x6A, 0xFC, 0x46, 0xD0, 0x73, 0xE5, 0x5F, 0xC9
+	.DB 0x3C, 0xAA, 0x10, 0x86, 0x25, 0xB3, 0x09, 0x9F
+	.DB 0x0E, 0x98, 0x22, 0xB4, 0x17, 0x81, 0x3B, 0xAD
+	.DB 0x20, 0xB6, 0x0C, 0x9A, 0x39, 0xAF, 0x15, 0x83
+	.DB 0x12, 0x84, 0x3E, 0xA8, 0x0B, 0x9D, 0x27, 0xB1
+	.DB 0x44, 0xD2, 0x68, 0xFE, 0x5D, 0xCB, 0x71, 0xE7
+	.DB 0x76, 0xE0, 0x5A, 0xCC, 0x6F, 0xF9, 0x43, 0xD5
+	.DB 0xE8, 0x7E, 0xC4, 0x52, 0xF1, 0x67, 0xDD, 0x4B
+	.DB 0xDA, 0x4C, 0xF6, 0x60, 0xC3, 0x55, 0xEF, 0x79
+	.DB 0x8C, 0x1A, 0xA0, 0x36, 0x95, 0x03, 0xB9, 0x2F
+	.DB 0xBE, 0x28, 0x92, 0x04, 0xA7, 0x31, 0x8B, 0x1D
+	.DB 0xB0, 0x26, 0x9C, 0x0A, 0xA9, 0x3F, 0x85, 0x13
+	.DB 0x82, 0x14, 0xAE, 0x38, 0x9B, 0x0D, 0xB7, 0x21
+	.DB 0xD4, 0x42, 0xF8, 0x6E, 0xCD, 0x5B, 0xE1, 0x77
+	.DB 0xE6, 0x70, 0xCA, 0x5C, 0xFF, 0x69, 0xD3, 0x45
+	.DB 0x78, 0xEE, 0x54, 0xC2, 0x61, 0xF7, 0x4D, 0xDB
+	.DB 0x4A, 0xDC, 0x66, 0xF0, 0x53, 0xC5, 0x7F, 0xE9
+	.DB 0x1C, 0x8A, 0x30, 0xA6, 0x05, 0x93, 0x29, 0xBF
+	.DB 0x2E, 0xB8, 0x02, 0x94, 0x37, 0xA1, 0x1B, 0x8D
+
+	.DB 0x00, 0x30, 0x61, 0x51, 0xC4, 0xF4, 0xA5, 0x95
+	.DB 0x88, 0xB8, 0xE9, 0xD9, 0x4C, 0x7C, 0x2D, 0x1D
+	.DB 0x10, 0x20, 0x71, 0x41, 0xD4, 0xE4, 0xB5, 0x85
+	.DB 0x98, 0xA8, 0xF9, 0xC9, 0x5C, 0x6C, 0x3D, 0x0D
+	.DB 0x20, 0x10, 0x41, 0x71, 0xE4, 0xD4, 0x85, 0xB5
+	.DB 0xA8, 0x98, 0xC9, 0xF9, 0x6C, 0x5C, 0x0D, 0x3D
+	.DB 0x30, 0x00, 0x51, 0x61, 0xF4, 0xC4, 0x95, 0xA5
+	.DB 0xB8, 0x88, 0xD9, 0xE9, 0x7C, 0x4C, 0x1D, 0x2D
+	.DB 0x41, 0x71, 0x20, 0x10, 0x85, 0xB5, 0xE4, 0xD4
+	.DB 0xC9, 0xF9, 0xA8, 0x98, 0x0D, 0x3D, 0x6C, 0x5C
+	.DB 0x51, 0x61, 0x30, 0x00, 0x95, 0xA5, 0xF4, 0xC4
+	.DB 0xD9, 0xE9, 0xB8, 0x88, 0x1D, 0x2D, 0x7C, 0x4C
+	.DB 0x61, 0x51, 0x00, 0x30, 0xA5, 0x95, 0xC4, 0xF4
+	.DB 0xE9, 0xD9, 0x88, 0xB8, 0x2D, 0x1D, 0x4C, 0x7C
+	.DB 0x71, 0x41, 0x10, 0x20, 0xB5, 0x85, 0xD4, 0xE4
+	.DB 0xF9, 0xC9, 0x98, 0xA8, 0x3D, 0x0D, 0x5C, 0x6C
+	.DB 0x83, 0xB3, 0xE2, 0xD2, 0x47, 0x77, 0x26, 0x16
+	.DB 0x0B, 0x3B, 0x6A, 0x5A, 0xCF, 0xFF, 0xAE, 0x9E
+	.DB 0x93, 0xA3, 0xF2, 0xC2, 0x57, 0x67, 0x36, 0x06
+	.DB 0x1B, 0x2B, 0x7A, 0x4A, 0xDF, 0xEF, 0xBE, 0x8E
+	.DB 0xA3, 0x93, 0xC2, 0xF2, 0x67, 0x57, 0x06, 0x36
+	.DB 0x2B, 0x1B, 0x4A, 0x7A, 0xEF, 0xDF, 0x8E, 0xBE
+	.DB 0xB3, 0x83, 0xD2, 0xE2, 0x77, 0x47, 0x16, 0x26
+	.DB 0x3B, 0x0B, 0x5A, 0x6A, 0xFF, 0xCF, 0x9E, 0xAE
+	.DB 0xC2, 0xF2, 0xA3, 0x93, 0x06, 0x36, 0x67, 0x57
+	.DB 0x4A, 0x7A, 0x2B, 0x1B, 0x8E, 0xBE, 0xEF, 0xDF
+	.DB 0xD2, 0xE2, 0xB3, 0x83, 0x16, 0x26, 0x77, 0x47
+	.DB 0x5A, 0x6A, 0x3B, 0x0B, 0x9E, 0xAE, 0xFF, 0xCF
+	.DB 0xE2, 0xD2, 0x83, 0xB3, 0x26, 0x16, 0x47, 0x77
+	.DB 0x6A, 0x5A, 0x0B, 0x3B, 0xAE, 0x9E, 0xCF, 0xFF
+	.DB 0xF2, 0xC2, 0x93, 0xA3, 0x36, 0x06, 0x57, 0x67
+	.DB 0x7A, 0x4A, 0x1B, 0x2B, 0xBE, 0x8E, 0xDF, 0xEF
+
+	.DB 0x00, 0x07, 0x0E, 0x09, 0x6D, 0x6A, 0x63, 0x64
+	.DB 0xDB, 0xDC, 0xD5, 0xD2, 0xB6, 0xB1, 0xB8, 0xBF
+	.DB 0xB7, 0xB0, 0xB9, 0xBE, 0xDA, 0xDD, 0xD4, 0xD3
+	.DB 0x6C, 0x6B, 0x62, 0x65, 0x01, 0x06, 0x0F, 0x08
+	.DB 0x6E, 0x69, 0x60, 0x67, 0x03, 0x04, 0x0D, 0x0A
+	.DB 0xB5, 0xB2, 0xBB, 0xBC, 0xD8, 0xDF, 0xD6, 0xD1
+	.DB 0xD9, 0xDE, 0xD7, 0xD0, 0xB4, 0xB3, 0xBA, 0xBD
+	.DB 0x02, 0x05, 0x0C, 0x0B, 0x6F, 0x68, 0x61, 0x66
+	.DB 0xDC, 0xDB, 0xD2, 0xD5, 0xB1, 0xB6, 0xBF, 0xB8
+	.DB 0x07, 0x00, 0x09, 0x0E, 0x6A, 0x6D, 0x64, 0x63
+	.DB 0x6B, 0x6C, 0x65, 0x62, 0x06, 0x01, 0x08, 0x0F
+	.DB 0xB0, 0xB7, 0xBE, 0xB9, 0xDD, 0xDA, 0xD3, 0xD4
+	.DB 0xB2, 0xB5, 0xBC, 0xBB, 0xDF, 0xD8, 0xD1, 0xD6
+	.DB 0x69, 0x6E, 0x67, 0x60, 0x04, 0x03, 0x0A, 0x0D
+	.DB 0x05, 0x02, 0x0B, 0x0C, 0x68, 0x6F, 0x66, 0x61
+	.DB 0xDE, 0xD9, 0xD0, 0xD7, 0xB3, 0xB4, 0xBD, 0xBA
+	.DB 0xB8, 0xBF, 0xB6, 0xB1, 0xD5, 0xD2, 0xDB, 0xDC
+	.DB 0x63, 0x64, 0x6D, 0x6A, 0x0E, 0x09, 0x00, 0x07
+	.DB 0x0F, 0x08, 0x01, 0x06, 0x62, 0x65, 0x6C, 0x6B
+	.DB 0xD4, 0xD3, 0xDA, 0xDD, 0xB9, 0xBE, 0xB7, 0xB0
+	.DB 0xD6, 0xD1, 0xD8, 0xDF, 0xBB, 0xBC, 0xB5, 0xB2
+	.DB 0x0D, 0x0A, 0x03, 0x04, 0x60, 0x67, 0x6E, 0x69
+	.DB 0x61, 0x66, 0x6F, 0x68, 0x0C, 0x0B, 0x02, 0x05
+	.DB 0xBA, 0xBD, 0xB4, 0xB3, 0xD7, 0xD0, 0xD9, 0xDE
+	.DB 0x64, 0x63, 0x6A, 0x6D, 0x09, 0x0E, 0x07, 0x00
+	.DB 0xBF, 0xB8, 0xB1, 0xB6, 0xD2, 0xD5, 0xDC, 0xDB
+	.DB 0xD3, 0xD4, 0xDD, 0xDA, 0xBE, 0xB9, 0xB0, 0xB7
+	.DB 0x08, 0x0F, 0x06, 0x01, 0x65, 0x62, 0x6B, 0x6C
+	.DB 0x0A, 0x0D, 0x04, 0x03, 0x67, 0x60, 0x69, 0x6E
+	.DB 0xD1, 0xD6, 0xDF, 0xD8, 0xBC, 0xBB, 0xB2, 0xB5
+	.DB 0xBD, 0xBA, 0xB3, 0xB4, 0xD0, 0xD7, 0xDE, 0xD9
+	.DB 0x66, 0x61, 0x68, 0x6F, 0x0B, 0x0C, 0x05, 0x02
+
+	.DB 0x00, 0x77, 0xEE, 0x99, 0x07, 0x70, 0xE9, 0x9E
+	.DB 0x0E, 0x79, 0xE0, 0x97, 0x09, 0x7E, 0xE7, 0x90
+	.DB 0x1D, 0x6A, 0xF3, 0x84, 0x1A, 0x6D, 0xF4, 0x83
+	.DB 0x13, 0x64, 0xFD, 0x8A, 0x14, 0x63, 0xFA, 0x8D
+	.DB 0x3B, 0x4C, 0xD5, 0xA2, 0x3C, 0x4B, 0xD2, 0xA5
+	.DB 0x35, 0x42, 0xDB, 0xAC, 0x32, 0x45, 0xDC, 0xAB
+	.DB 0x26, 0x51, 0xC8, 0xBF, 0x21, 0x56, 0xCF, 0xB8
+	.DB 0x28, 0x5F, 0xC6, 0xB1, 0x2F, 0x58, 0xC1, 0xB6
+	.DB 0x76, 0x01, 0x98, 0xEF, 0x71, 0x06, 0x9F, 0xE8
+	.DB 0x78, 0x0F, 0x96, 0xE1, 0x7F, 0x08, 0x91, 0xE6
+	.DB 0x6B, 0x1C, 0x85, 0xF2, 0x6C, 0x1B, 0x82, 0xF5
+	.DB 0x65, 0x12, 0x8B, 0xFC, 0x62, 0x15, 0x8C, 0xFB
+	.DB 0x4D, 0x3A, 0xA3, 0xD4, 0x4A, 0x3D, 0xA4, 0xD3
+	.DB 0x43, 0x34, 0xAD, 0xDA, 0x44, 0x33, 0xAA, 0xDD
+	.DB 0x50, 0x27, 0xBE, 0xC9, 0x57, 0x20, 0xB9, 0xCE
+	.DB 0x5E, 0x29, 0xB0, 0xC7, 0x59, 0x2E, 0xB7, 0xC0
+	.DB 0xED, 0x9A, 0x03, 0x74, 0xEA, 0x9D, 0x04, 0x73
+	.DB 0xE3, 0x94, 0x0D, 0x7A, 0xE4, 0x93, 0x0A, 0x7D
+	.DB 0xF0, 0x87, 0x1E, 0x69, 0xF7, 0x80, 0x19, 0x6E
+	.DB 0xFE, 0x89, 0x10, 0x67, 0xF9, 0x8E, 0x17, 0x60
+	.DB 0xD6, 0xA1, 0x38, 0x4F, 0xD1, 0xA6, 0x3F, 0x48
+	.DB 0xD8, 0xAF, 0x36, 0x41, 0xDF, 0xA8, 0x31, 0x46
+	.DB 0xCB, 0xBC, 0x25, 0x52, 0xCC, 0xBB, 0x22, 0x55
+	.DB 0xC5, 0xB2, 0x2B, 0x5C, 0xC2, 0xB5, 0x2C, 0x5B
+	.DB 0x9B, 0xEC, 0x75, 0x02, 0x9C, 0xEB, 0x72, 0x05
+	.DB 0x95, 0xE2, 0x7B, 0x0C, 0x92, 0xE5, 0x7C, 0x0B
+	.DB 0x86, 0xF1, 0x68, 0x1F, 0x81, 0xF6, 0x6F, 0x18
+	.DB 0x88, 0xFF, 0x66, 0x11, 0x8F, 0xF8, 0x61, 0x16
+	.DB 0xA0, 0xD7, 0x4E, 0x39, 0xA7, 0xD0, 0x49, 0x3E
+	.DB 0xAE, 0xD9, 0x40, 0x37, 0xA9, 0xDE, 0x47, 0x30
+	.DB 0xBD, 0xCA, 0x53, 0x24, 0xBA, 0xCD, 0x54, 0x23
+	.DB 0xB3, 0xC4, 0x5D, 0x2A, 0xB4, 0xC3, 0x5A, 0x2D
+
 	.END
 
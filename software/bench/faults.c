@@ -0,0 +1,309 @@
+/*
+ * Emrom - ROM emulator software
+ * Copyright (c) 2016 rksdna
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "../test/sim.h"
+#include "../errors.h"
+
+#define IMAGE_ORIGIN 0x1000
+#define IMAGE_SIZE 0x400
+#define SESSIONS 8
+#define SAMPLES (SESSIONS * 4 * IMAGE_SIZE / DEVICE_PAGE_SIZE)
+#define QUEUE_SIZE 0x10000
+#define BYTE_TIME (10.0 / 57600)
+#define TIMEOUT 100
+#define DRAIN_TIME 0.1
+
+struct faults
+{
+    double drop;
+    double flip;
+    double latency;
+    double jitter;
+};
+
+struct stand
+{
+    volatile struct faults faults;
+};
+
+struct queue
+{
+    double time[QUEUE_SIZE];
+    char data[QUEUE_SIZE];
+    size_t head;
+    size_t tail;
+    double last;
+};
+
+static const struct faults clean;
+
+static const struct faults sweep[] =
+{
+    {0, 0, 0, 0},
+    {1e-4, 0, 0, 0},
+    {1e-3, 0, 0, 0},
+    {0, 1e-4, 0, 0},
+    {0, 1e-3, 0, 0},
+    {0, 0, 0.005, 0},
+    {0, 0, 0.005, 0.005},
+    {1e-4, 1e-4, 0.002, 0.002}
+};
+
+static struct stand *stand;
+static struct sim sim;
+static uint8_t image[IMAGE_SIZE];
+static double samples[SAMPLES];
+static size_t sample_count;
+static double mark;
+
+static void push(struct queue *queue, char c)
+{
+    const struct faults *faults = (const struct faults *)&stand->faults;
+    double time = get_time() + faults->latency + faults->jitter * drand48();
+
+    if (drand48() < faults->drop || queue->head - queue->tail == QUEUE_SIZE)
+        return;
+
+    if (drand48() < faults->flip)
+        c ^= 1 << (lrand48() % 8);
+
+    if (time < queue->last + BYTE_TIME)
+        time = queue->last + BYTE_TIME;
+
+    queue->time[queue->head % QUEUE_SIZE] = time;
+    queue->data[queue->head++ % QUEUE_SIZE] = c;
+    queue->last = time;
+}
+
+static void send_reply(void *context, const char *data, size_t size)
+{
+    while (size--)
+        push(context, *data++);
+}
+
+static void deliver(struct queue *queue, double time, int feed)
+{
+    while (queue->tail < queue->head && queue->time[queue->tail % QUEUE_SIZE] <= time)
+    {
+        char c = queue->data[queue->tail++ % QUEUE_SIZE];
+
+        if (feed)
+            feed_sim(&sim, &c, 1);
+        else if (write(sim.fd, &c, 1) < 0)
+            exit(1);
+    }
+}
+
+static int wait_time(const struct queue *queue, double time)
+{
+    double wait = 1;
+
+    if (queue->tail < queue->head)
+        wait = queue->time[queue->tail % QUEUE_SIZE] - time;
+
+    return wait > 0 ? wait * 1000 + 1 : 0;
+}
+
+static void simulate(struct sim *sim)
+{
+    static struct queue request;
+    static struct queue response;
+    struct pollfd poller = {sim->fd, POLLIN, 0};
+
+    srand48(getpid());
+    sim->send = send_reply;
+    sim->context = &response;
+
+    while (1)
+    {
+        double time = get_time();
+        int wait = wait_time(&request, time);
+
+        if (wait_time(&response, time) < wait)
+            wait = wait_time(&response, time);
+
+        if (poll(&poller, 1, wait) < 0)
+            exit(1);
+
+        if (poller.revents & POLLIN)
+        {
+            char data[4096];
+            ssize_t size = read(sim->fd, data, sizeof(data));
+            ssize_t i;
+
+            if (size <= 0)
+                exit(0);
+
+            for (i = 0; i < size; i++)
+                push(&request, data[i]);
+        }
+
+        time = get_time();
+        deliver(&request, time, 1);
+        deliver(&response, time, 0);
+    }
+}
+
+static void record(void *context, uint32_t address, size_t size)
+{
+    double time = get_time();
+
+    if (sample_count < SAMPLES)
+        samples[sample_count++] = time - mark;
+
+    mark = time;
+}
+
+static int compare(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int reconnect(struct device *device, const char *file)
+{
+    int result;
+    int i;
+
+    stand->faults = clean;
+    usleep(1e6 * DRAIN_TIME);
+    close_device(device);
+
+    if ((result = open_device(device, file)) || (result = set_device_timeout(device, TIMEOUT)))
+        return result;
+
+    for (i = 0; i < 3; i++)
+    {
+        struct probe probe;
+
+        if ((result = probe_device(device, 1, &probe)) == DONE)
+            return DONE;
+    }
+
+    return result;
+}
+
+static int measure(struct device *device, const char *file, const struct faults *faults, size_t window)
+{
+    struct buffer buffer = {0, IMAGE_ORIGIN, IMAGE_SIZE, image};
+    double total = 0;
+    size_t bytes = 0;
+    int passed = 0;
+    int result;
+    int i;
+
+    sample_count = 0;
+
+    for (i = 0; i < SESSIONS; i++)
+    {
+        double time;
+        int j;
+
+        if ((result = reconnect(device, file)) || (result = set_device_window(device, window)))
+            return result;
+
+        for (j = 0; j < IMAGE_SIZE; j++)
+            image[j] = rand();
+
+        memset(sim.memory + IMAGE_ORIGIN, 0xFF, IMAGE_SIZE);
+        stand->faults = *faults;
+
+        time = mark = get_time();
+        result = write_device_memory(device, &buffer);
+        total += get_time() - time;
+
+        if (!result && !memcmp(sim.memory + IMAGE_ORIGIN, image, IMAGE_SIZE))
+        {
+            bytes += IMAGE_SIZE;
+            passed++;
+        }
+    }
+
+    qsort(samples, sample_count, sizeof(double), compare);
+
+    fprintf(stdout, "drop %.0e flip %.0e latency %2.0f ms jitter %2.0f ms window %zu: %6.0f B/s goodput, %6.1f ms p99 page, %3d%% sessions\n",
+        faults->drop, faults->flip, 1e3 * faults->latency, 1e3 * faults->jitter, window,
+        bytes / total, sample_count ? 1e3 * samples[(sample_count * 99 + 99) / 100 - 1] : 0, 100 * passed / SESSIONS);
+
+    return DONE;
+}
+
+int main(int argc, char *argv[])
+{
+    struct faults faults;
+    struct identity identity;
+    struct device *device;
+    size_t window;
+    int i;
+
+    if (argc != 1 && argc != 5)
+    {
+        fprintf(stderr, "usage: %s [DROP FLIP LATENCY_MS JITTER_MS]\n", argv[0]);
+        return INVALID_OPTIONS_ARGUMENT;
+    }
+
+    if ((stand = mmap(0, sizeof(struct stand), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+        return INTERNAL_ERROR;
+
+    if (open_sim(&sim) || start_sim(&sim, simulate))
+        return INTERNAL_ERROR;
+
+    if (!(device = create_device()) || open_device(device, sim.file) || set_device_timeout(device, TIMEOUT) || identify_device(device, &identity))
+        return INTERNAL_ERROR;
+
+    watch_device(device, record, 0);
+
+    for (i = 0; i < sizeof(sweep) / sizeof(sweep[0]) || argc == 5 && i == 0; i++)
+    {
+        faults = sweep[i];
+
+        if (argc == 5)
+        {
+            faults.drop = atof(argv[1]);
+            faults.flip = atof(argv[2]);
+            faults.latency = atof(argv[3]) / 1e3;
+            faults.jitter = atof(argv[4]) / 1e3;
+        }
+
+        for (window = 1; window <= identity.queue; window *= 4)
+        {
+            if (measure(device, sim.file, &faults, window))
+                return INTERNAL_ERROR;
+        }
+
+        if (argc == 5)
+            break;
+    }
+
+    destroy_device(device);
+    close_sim(&sim);
+    return DONE;
+}
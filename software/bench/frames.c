@@ -0,0 +1,101 @@
+/*
+ * Emrom - ROM emulator software
+ * Copyright (c) 2016 rksdna
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include "../test/sim.h"
+#include "../errors.h"
+
+#define ROUNDS 64
+
+static uint8_t memory[DEVICE_MEMORY_SIZE];
+static struct sim sim;
+
+static double cpu_time(void)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    struct buffer buffer = {0, 0, DEVICE_MEMORY_SIZE, memory};
+    struct identity identity;
+    struct settings settings;
+    struct device *device;
+    double time;
+    size_t window;
+    int i;
+
+    if (open_sim(&sim))
+        return INTERNAL_ERROR;
+
+    sim.identity.commands = DEVICE_READ_COMMAND | DEVICE_WRITE_COMMAND | DEVICE_PATCH_COMMAND | DEVICE_IDENTIFY_COMMAND;
+    sim.identity.queue = DEVICE_WINDOW_LIMIT;
+    sim.identity.features = 0;
+
+    if (start_sim(&sim, 0))
+        return INTERNAL_ERROR;
+
+    for (i = 0; i < DEVICE_MEMORY_SIZE; i++)
+        memory[i] = rand();
+
+    if (!(device = create_device()) || open_device(device, sim.file) || identify_device(device, &identity))
+        return INTERNAL_ERROR;
+
+    for (window = 1; window <= DEVICE_WINDOW_LIMIT; window *= 4)
+    {
+        if (set_device_window(device, window))
+            return INTERNAL_ERROR;
+
+        get_device_settings(device, &settings);
+        time = cpu_time();
+
+        for (i = 0; i < ROUNDS; i++)
+        {
+            if (write_device_memory(device, &buffer))
+                return INTERNAL_ERROR;
+        }
+
+        time = cpu_time() - time;
+        fprintf(stdout, "write window %2zu: %8.1f us CPU per 64 KB\n", settings.window, 1e6 * time / ROUNDS);
+    }
+
+    time = cpu_time();
+
+    for (i = 0; i < ROUNDS; i++)
+    {
+        if (read_device_memory(device, &buffer))
+            return INTERNAL_ERROR;
+    }
+
+    time = cpu_time() - time;
+    fprintf(stdout, "read:            %8.1f us CPU per 64 KB\n", 1e6 * time / ROUNDS);
+
+    destroy_device(device);
+    close_sim(&sim);
+    return DONE;
+}
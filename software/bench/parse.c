@@ -0,0 +1,148 @@
+/*
+ * Emrom - ROM emulator software
+ * Copyright (c) 2016 rksdna
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include "../buffer.h"
+#include "../errors.h"
+
+#define IMAGE_SIZE 0x100000
+#define ROUNDS 8
+#define LOG_LINE_SIZE 256
+
+static uint8_t memory[IMAGE_SIZE];
+
+static double cpu_time(void)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static int track(const char *file, const char *commit, double limit, double save, double load)
+{
+    char line[LOG_LINE_SIZE];
+    char base[LOG_LINE_SIZE] = "";
+    double base_save = 0;
+    double base_load = 0;
+    int result = DONE;
+    FILE *stream;
+
+    if ((stream = fopen(file, "r")))
+    {
+        while (fgets(line, sizeof(line), stream))
+        {
+            char id[LOG_LINE_SIZE];
+            double x;
+            double y;
+
+            if (sscanf(line, "%255s %lf %lf", id, &x, &y) == 3 && strcmp(id, commit))
+            {
+                strcpy(base, id);
+                base_save = x;
+                base_load = y;
+            }
+        }
+
+        fclose(stream);
+    }
+
+    if (*base && (save < base_save * (1 - limit / 100) || load < base_load * (1 - limit / 100)))
+    {
+        fprintf(stdout, "regression over %.0f%% against %s: save %.1f -> %.1f MB/s, load %.1f -> %.1f MB/s\n",
+            limit, base, base_save, save, base_load, load);
+        result = INTERNAL_ERROR;
+    }
+
+    if (!(stream = fopen(file, "a")))
+        return INTERNAL_ERROR;
+
+    fprintf(stream, "%s %.1f %.1f\n", commit, save, load);
+
+    if (fclose(stream))
+        return INTERNAL_ERROR;
+
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    struct buffer buffer = {0, 0, IMAGE_SIZE, memory};
+    char file[] = "/tmp/emrom-bench-XXXXXX";
+    struct stat status;
+    double save;
+    double load;
+    double time;
+    int fd;
+    int i;
+
+    if (argc != 1 && argc != 4)
+    {
+        fprintf(stderr, "usage: %s [LOG COMMIT LIMIT_PERCENT]\n", argv[0]);
+        return INVALID_OPTIONS_ARGUMENT;
+    }
+
+    for (i = 0; i < IMAGE_SIZE; i++)
+        memory[i] = rand();
+
+    if ((fd = mkstemp(file)) < 0)
+        return INTERNAL_ERROR;
+
+    close(fd);
+    time = cpu_time();
+
+    for (i = 0; i < ROUNDS; i++)
+    {
+        if (save_file_buffer(&buffer, file))
+            return INTERNAL_ERROR;
+    }
+
+    time = cpu_time() - time;
+
+    if (stat(file, &status))
+        return INTERNAL_ERROR;
+
+    save = ROUNDS * status.st_size / time / 1e6;
+    fprintf(stdout, "save hex: %8.1f MB/s\n", save);
+    time = cpu_time();
+
+    for (i = 0; i < ROUNDS; i++)
+    {
+        struct buffer image = {0, 0, IMAGE_SIZE, memory};
+
+        if (load_file_buffer(&image, file))
+            return INTERNAL_ERROR;
+    }
+
+    time = cpu_time() - time;
+    load = ROUNDS * status.st_size / time / 1e6;
+    fprintf(stdout, "load hex: %8.1f MB/s\n", load);
+
+    unlink(file);
+    return argc == 4 ? track(argv[1], argv[2], atof(argv[3]), save, load) : DONE;
+}
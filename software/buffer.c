@@ -22,14 +22,25 @@
  */
 
 #include <stdio.h>
+#include <ctype.h>
+#include <fcntl.h>
 #include <memory.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "errors.h"
 #include "buffer.h"
 
 #define INTEL_DATA 0x00
 #define INTEL_END_OF_FILE 0x01
+#define INTEL_SEGMENT_ADDRESS 0x02
+#define INTEL_SEGMENT_START_ADDRESS 0x03
 #define INTEL_EXTENDED_ADDRESS 0x04
 #define INTEL_START_ADDRESS 0x05
+#define INTEL_HEAD_SIZE 4
+#define INTEL_RECORD_SIZE (INTEL_HEAD_SIZE + 0xFF + 1)
+#define INTEL_LINE_SIZE (1 + 2 * INTEL_RECORD_SIZE + 16)
+#define PART_SUFFIX ".part"
 
 struct load_context
 {
@@ -39,7 +50,12 @@ struct load_context
     uint32_t origin;
     size_t size;
     uint8_t *data;
-    uint16_t shadow;
+    uint8_t *mask;
+    uint32_t base;
+    int skip;
+    int end;
+    record_handler_t handler;
+    void *handler_context;
 };
 
 struct save_context
@@ -58,26 +74,114 @@ static uint8_t *ihex32_data(struct load_context *context, uint32_t address)
     return 0;
 }
 
+static int decode_nibble(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 0x0A;
+
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 0x0A;
+
+    return -1;
+}
+
+static int decode_ihex32_bytes(const char *text, uint8_t *data, size_t count)
+{
+    while (count--)
+    {
+        int high = decode_nibble(*text++);
+        int low = decode_nibble(*text++);
+
+        if (high < 0 || low < 0)
+            return INVALID_FILE_CONTENT;
+
+        *data++ = high << 4 | low;
+    }
+
+    return DONE;
+}
+
+static int ihex32_outside(struct load_context *context, uint16_t offset, uint8_t size)
+{
+    uint64_t first = (uint64_t)context->base + offset;
+
+    if (!context->skip || offset + size > 0x10000)
+        return 0;
+
+    return first + size <= context->origin || first >= (uint64_t)context->origin + context->size;
+}
+
 static int read_ihex32_chunk(struct load_context *context, FILE *stream)
 {
-    uint8_t size, scratch, checksum;
+    char line[INTEL_LINE_SIZE];
+    uint8_t record[INTEL_RECORD_SIZE];
+    uint8_t checksum = 0;
+    size_t length;
     uint16_t offset;
+    int result;
+    int i;
 
-    if (fscanf(stream, ":%02hhX%04hX%02hhX", &size, &offset, &scratch) != 3)
-        return INTERNAL_ERROR;
+    if (!fgets(line, sizeof(line), stream))
+    {
+        if (ferror(stream))
+            return INTERNAL_ERROR;
 
-    checksum = size + scratch + offset + (offset >> 8);
+        context->end = 1;
+        return DONE;
+    }
+
+    length = strlen(line);
+
+    if (!length || line[length - 1] != '\n' && !feof(stream))
+        return INVALID_FILE_CONTENT;
+
+    while (length && isspace((unsigned char)line[length - 1]))
+        length--;
+
+    if (!length)
+        return DONE;
+
+    if (line[0] != ':' || length % 2 != 1 || length < 1 + 2 * (INTEL_HEAD_SIZE + 1) || length > 1 + 2 * INTEL_RECORD_SIZE)
+        return INVALID_FILE_CONTENT;
+
+    if ((result = decode_ihex32_bytes(line + 1, record, INTEL_HEAD_SIZE)))
+        return result;
+
+    if (length != 1 + 2 * (INTEL_HEAD_SIZE + record[0] + 1))
+        return INVALID_FILE_CONTENT;
 
-    switch (scratch)
+    offset = record[1] << 8 | record[2];
+
+    if (record[3] == INTEL_DATA && ihex32_outside(context, offset, record[0]))
+        return DONE;
+
+    if ((result = decode_ihex32_bytes(line + 1 + 2 * INTEL_HEAD_SIZE, record + INTEL_HEAD_SIZE, record[0] + 1)))
+        return result;
+
+    for (i = 0; i < INTEL_HEAD_SIZE + record[0] + 1; i++)
+        checksum += record[i];
+
+    if (checksum)
+        return INVALID_FILE_CHECKSUM;
+
+    switch (record[3])
     {
     case INTEL_DATA:
-        while (size--)
+        for (i = 0; i < record[0]; i++)
         {
-            uint32_t address = (context->shadow << 16) + offset++;
+            uint32_t address = context->base + (uint16_t)(offset + i);
             uint8_t *data = ihex32_data(context, address);
 
             if (!data)
+            {
+                if (context->skip)
+                    continue;
+
                 return INVALID_FILE_CONTENT;
+            }
 
             if (address > context->max)
                 context->max = address;
@@ -85,65 +189,67 @@ static int read_ihex32_chunk(struct load_context *context, FILE *stream)
             if (address < context->min)
                 context->min = address;
 
-            if (fscanf(stream, "%02hhX", &scratch) != 1)
-                return INTERNAL_ERROR;
+            *data = record[INTEL_HEAD_SIZE + i];
 
-            checksum += scratch;
-            *data = scratch;
+            if (context->mask)
+                context->mask[data - context->data] = 1;
         }
+
+        if (context->handler && record[0] && (result = context->handler(context->handler_context, context->base + offset, record[0])))
+            return result;
+
         break;
 
     case INTEL_END_OF_FILE:
+        if (record[0] != 0)
+            return INVALID_FILE_CONTENT;
+
+        context->end = 1;
         break;
 
+    case INTEL_SEGMENT_ADDRESS:
     case INTEL_EXTENDED_ADDRESS:
-        if (fscanf(stream, "%04hX", &context->shadow) != 1)
-            return INTERNAL_ERROR;
+        if (record[0] != 2)
+            return INVALID_FILE_CONTENT;
+
+        context->base = (uint32_t)(record[4] << 8 | record[5]) << (record[3] == INTEL_EXTENDED_ADDRESS ? 16 : 4);
+        break;
 
-        checksum += context->shadow + (context->shadow >> 8);
+    case INTEL_SEGMENT_START_ADDRESS:
+        if (record[0] != 4)
+            return INVALID_FILE_CONTENT;
+
+        context->startup = ((record[4] << 8 | record[5]) << 4) + (record[6] << 8 | record[7]);
         break;
 
     case INTEL_START_ADDRESS:
-        if (fscanf(stream, "%08X", &context->startup) != 1)
-            return INTERNAL_ERROR;
+        if (record[0] != 4)
+            return INVALID_FILE_CONTENT;
 
-        checksum += context->startup + (context->startup >> 8) + (context->startup >> 16) + (context->startup >> 24);
+        context->startup = (uint32_t)record[4] << 24 | record[5] << 16 | record[6] << 8 | record[7];
         break;
 
     default:
         return INVALID_FILE_CONTENT;
     }
 
-    if (fscanf(stream, "%02hhX\n", &scratch) != 1)
-        return INTERNAL_ERROR;
-
-    if ((uint8_t)(checksum + scratch))
-        return INVALID_FILE_CHECKSUM;
-
     return DONE;
 }
 
-int load_file_buffer(struct buffer *buffer, const char *file)
+static int read_ihex32_stream(struct buffer *buffer, FILE *stream, int skip, record_handler_t handler, void *handler_context)
 {
     struct load_context context =
     {
-        0, 0xFFFFFFFF, 0x00000000, buffer->origin, buffer->size, (uint8_t *)buffer->data, 0
+        0, 0xFFFFFFFF, 0x00000000, buffer->origin, buffer->size, (uint8_t *)buffer->data, buffer->mask, 0, skip, 0, handler, handler_context
     };
 
-    FILE *stream = fopen(file, "rt");
-    if (!stream)
-        return INTERNAL_ERROR;
-
-    while (!feof(stream))
+    while (!context.end)
     {
         int result;
         if ((result = read_ihex32_chunk(&context, stream)))
             return result;
     }
 
-    if (fclose(stream))
-        return INTERNAL_ERROR;
-
     buffer->startup = context.startup;
 
     if (context.min > context.max)
@@ -154,12 +260,57 @@ int load_file_buffer(struct buffer *buffer, const char *file)
     {
         buffer->size = context.max - context.min + 1;
         buffer->data = buffer->data + context.min - buffer->origin;
+
+        if (buffer->mask)
+            buffer->mask = buffer->mask + context.min - buffer->origin;
+
         buffer->origin = context.min;
     }
 
     return DONE;
 }
 
+static int read_ihex32_file(struct buffer *buffer, const char *file, int skip)
+{
+    int result;
+    FILE *stream = fopen(file, "rt");
+
+    if (!stream)
+        return INTERNAL_ERROR;
+
+    result = read_ihex32_stream(buffer, stream, skip, 0, 0);
+
+    if (fclose(stream) && !result)
+        return INTERNAL_ERROR;
+
+    return result;
+}
+
+int load_file_buffer(struct buffer *buffer, const char *file)
+{
+    return read_ihex32_file(buffer, file, 0);
+}
+
+int load_stream_buffer(struct buffer *buffer, FILE *stream)
+{
+    return read_ihex32_stream(buffer, stream, 0, 0, 0);
+}
+
+int feed_stream_buffer(struct buffer *buffer, FILE *stream, record_handler_t handler, void *context)
+{
+    return read_ihex32_stream(buffer, stream, 0, handler, context);
+}
+
+int extract_file_buffer(struct buffer *buffer, const char *file)
+{
+    return read_ihex32_file(buffer, file, 1);
+}
+
+int extract_stream_buffer(struct buffer *buffer, FILE *stream)
+{
+    return read_ihex32_stream(buffer, stream, 1, 0, 0);
+}
+
 static int write_ihex32_data(struct save_context *context, FILE *stream, uint8_t size)
 {
     uint8_t checksum;
@@ -211,17 +362,13 @@ static size_t ihex32_size(struct save_context *context)
     return end - context->origin;
 }
 
-int save_file_buffer(struct buffer *buffer, const char *file)
+int save_stream_buffer(struct buffer *buffer, FILE *stream)
 {
     struct save_context context =
     {
         buffer->origin, buffer->size, (const uint8_t *)buffer->data, 0
     };
 
-    FILE *stream = fopen(file, "wt");
-    if (!stream)
-        return INTERNAL_ERROR;
-
     while (context.size)
     {
         int result;
@@ -237,12 +384,182 @@ int save_file_buffer(struct buffer *buffer, const char *file)
     if (fprintf(stream, ":00000001FF\n") != 12)
         return INTERNAL_ERROR;
 
-    if (fclose(stream))
+    return DONE;
+}
+
+int save_file_buffer(struct buffer *buffer, const char *file)
+{
+    int result;
+    FILE *stream = fopen(file, "wt");
+
+    if (!stream)
+        return INTERNAL_ERROR;
+
+    result = save_stream_buffer(buffer, stream);
+
+    if (fclose(stream) && !result)
+        return INTERNAL_ERROR;
+
+    return result;
+}
+
+static int part_file(char *part, const char *file)
+{
+    if (snprintf(part, PATH_MAX, "%s" PART_SUFFIX, file) >= PATH_MAX)
         return INTERNAL_ERROR;
 
     return DONE;
 }
 
+int map_file_buffer(struct buffer *buffer, const char *file)
+{
+    char part[PATH_MAX];
+    void *data;
+    int fd;
+
+    if (part_file(part, file) || (fd = open(part, O_RDWR | O_CREAT | O_TRUNC, 0666)) < 0)
+        return INTERNAL_ERROR;
+
+    if (ftruncate(fd, buffer->size) < 0)
+    {
+        close(fd);
+        unlink(part);
+        return INTERNAL_ERROR;
+    }
+
+    data = buffer->size ? mmap(0, buffer->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : 0;
+
+    if (close(fd) < 0 || data == MAP_FAILED)
+    {
+        unlink(part);
+        return INTERNAL_ERROR;
+    }
+
+    buffer->data = data;
+    return DONE;
+}
+
+int unmap_file_buffer(struct buffer *buffer, const struct buffer *region, const char *file)
+{
+    char part[PATH_MAX];
+
+    if (part_file(part, file))
+        return INTERNAL_ERROR;
+
+    if (region && region->data != buffer->data)
+        memmove(buffer->data, region->data, region->size);
+
+    if (buffer->size && munmap(buffer->data, buffer->size) < 0)
+    {
+        unlink(part);
+        return INTERNAL_ERROR;
+    }
+
+    if (!region)
+    {
+        unlink(part);
+        return DONE;
+    }
+
+    if (truncate(part, region->size) < 0 || rename(part, file) < 0)
+    {
+        unlink(part);
+        return INTERNAL_ERROR;
+    }
+
+    return DONE;
+}
+
+int fold_buffer(struct buffer *buffer, size_t size)
+{
+    uint8_t *data = buffer->data;
+    size_t i;
+
+    for (i = 0; i < buffer->size; i++)
+    {
+        int64_t index = (int64_t)(buffer->origin + i) % size - buffer->origin;
+
+        if (!buffer->mask[i] || index == i)
+            continue;
+
+        if (index < 0 || index >= buffer->size)
+            return INVALID_FILE_CONTENT;
+
+        if (buffer->mask[index] && data[index] != data[i])
+            return OVERLAPPING_FILE_CONTENT;
+
+        data[index] = data[i];
+        buffer->mask[index] = 1;
+        buffer->mask[i] = 0;
+    }
+
+    if (buffer->size > size)
+        buffer->size = size;
+
+    return DONE;
+}
+
+void trim_buffer(struct buffer *buffer, uint8_t value)
+{
+    uint8_t *data = buffer->data;
+
+    while (buffer->size && data[buffer->size - 1] == value)
+        buffer->size--;
+
+    while (buffer->size && *data == value)
+    {
+        buffer->origin++;
+        buffer->size--;
+        data++;
+    }
+
+    buffer->data = data;
+}
+
+int merge_buffer(struct buffer *buffer, const struct buffer *source, int32_t offset, enum conflict conflict)
+{
+    size_t i;
+
+    for (i = 0; i < source->size; i++)
+    {
+        const uint8_t *data = source->data;
+        int64_t index = (int64_t)source->origin + i + offset - buffer->origin;
+
+        if (source->mask && !source->mask[i])
+            continue;
+
+        if (index < 0 || index >= buffer->size)
+            return INVALID_FILE_CONTENT;
+
+        if (buffer->mask[index])
+        {
+            if (conflict == FAIL_CONFLICT)
+                return OVERLAPPING_FILE_CONTENT;
+
+            if (conflict == KEEP_CONFLICT)
+                continue;
+        }
+
+        ((uint8_t *)buffer->data)[index] = data[i];
+        buffer->mask[index] = 1;
+    }
+
+    return DONE;
+}
+
+void cover_buffer_pages(struct buffer *buffer, size_t page)
+{
+    size_t i;
+
+    for (i = 0; i < buffer->size; i += page)
+    {
+        size_t count = buffer->size - i < page ? buffer->size - i : page;
+
+        if (memchr(buffer->mask + i, 1, count))
+            memset(buffer->mask + i, 1, count);
+    }
+}
+
 void clear_buffer(struct buffer *buffer, uint8_t value)
 {
     memset(buffer->data, value, buffer->size);
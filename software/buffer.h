@@ -26,6 +26,14 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdio.h>
+
+enum conflict
+{
+    REPLACE_CONFLICT,
+    KEEP_CONFLICT,
+    FAIL_CONFLICT
+};
 
 struct buffer
 {
@@ -33,10 +41,24 @@ struct buffer
     uint32_t origin;
     size_t size;
     void *data;
+    uint8_t *mask;
 };
 
+typedef int (* record_handler_t)(void *context, uint32_t address, size_t size);
+
 int load_file_buffer(struct buffer *buffer, const char *file);
+int load_stream_buffer(struct buffer *buffer, FILE *stream);
+int feed_stream_buffer(struct buffer *buffer, FILE *stream, record_handler_t handler, void *context);
+int extract_file_buffer(struct buffer *buffer, const char *file);
+int extract_stream_buffer(struct buffer *buffer, FILE *stream);
 int save_file_buffer(struct buffer *buffer, const char *file);
+int save_stream_buffer(struct buffer *buffer, FILE *stream);
+int map_file_buffer(struct buffer *buffer, const char *file);
+int unmap_file_buffer(struct buffer *buffer, const struct buffer *region, const char *file);
+int merge_buffer(struct buffer *buffer, const struct buffer *source, int32_t offset, enum conflict conflict);
+int fold_buffer(struct buffer *buffer, size_t size);
+void cover_buffer_pages(struct buffer *buffer, size_t page);
+void trim_buffer(struct buffer *buffer, uint8_t value);
 void clear_buffer(struct buffer *buffer, uint8_t value);
 
 #endif
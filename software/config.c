@@ -0,0 +1,144 @@
+/*
+ * Emrom - ROM emulator software
+ * Copyright (c) 2016 rksdna
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include "errors.h"
+#include "config.h"
+
+#define LINE_SIZE 1024
+
+static int parse_settings(char *line, const char *port, struct settings *settings)
+{
+    char *state;
+    char *p = strtok_r(line, " \t\n", &state);
+
+    if (!p || *p == '#' || strcmp(p, port))
+        return 0;
+
+    while ((p = strtok_r(0, " \t\n", &state)))
+    {
+        if (sscanf(p, "window=%zu", &settings->window) == 1)
+            continue;
+
+        if (sscanf(p, "latency=%d", &settings->latency) == 1)
+            continue;
+
+        if (sscanf(p, "timeout=%d", &settings->timeout) == 1)
+            continue;
+
+        if (sscanf(p, "protocol=%d", &settings->identity.protocol) == 1)
+            continue;
+
+        if (sscanf(p, "frame=%zu", &settings->identity.frame) == 1)
+            continue;
+
+        if (sscanf(p, "commands=%i", &settings->identity.commands) == 1)
+            continue;
+
+        if (sscanf(p, "memory=%zu", &settings->identity.memory) == 1)
+            continue;
+
+        if (sscanf(p, "queue=%zu", &settings->identity.queue) == 1)
+            continue;
+
+        if (sscanf(p, "features=%i", &settings->identity.features) == 1)
+            continue;
+    }
+
+    return 1;
+}
+
+static int print_settings(FILE *stream, const char *port, const struct settings *settings)
+{
+    const struct identity *identity = &settings->identity;
+
+    return fprintf(stream, "%s window=%zu latency=%d timeout=%d protocol=%d frame=%zu commands=0x%.2X memory=%zu queue=%zu features=0x%.2X\n",
+        port, settings->window, settings->latency, settings->timeout,
+        identity->protocol, identity->frame, identity->commands, identity->memory, identity->queue, identity->features) < 0;
+}
+
+int load_settings(const char *file, const char *port, struct settings *settings)
+{
+    char line[LINE_SIZE];
+    int result = MISSING_SETTINGS;
+    FILE *stream = fopen(file, "rt");
+
+    if (!stream)
+        return errno == ENOENT ? MISSING_SETTINGS : INTERNAL_ERROR;
+
+    while (fgets(line, sizeof(line), stream))
+    {
+        if (parse_settings(line, port, settings))
+            result = DONE;
+    }
+
+    if (fclose(stream))
+        return INTERNAL_ERROR;
+
+    return result;
+}
+
+int save_settings(const char *file, const char *port, const struct settings *settings)
+{
+    char line[LINE_SIZE];
+    char copy[LINE_SIZE];
+    char temporary[LINE_SIZE];
+    struct settings scratch;
+    FILE *source = fopen(file, "rt");
+    FILE *target;
+
+    if (!source && errno != ENOENT)
+        return INTERNAL_ERROR;
+
+    if (snprintf(temporary, sizeof(temporary), "%s.tmp", file) >= sizeof(temporary) || !(target = fopen(temporary, "wt")))
+    {
+        if (source)
+            fclose(source);
+
+        return INTERNAL_ERROR;
+    }
+
+    while (source && fgets(line, sizeof(line), source))
+    {
+        strcpy(copy, line);
+
+        if (!parse_settings(copy, port, &scratch))
+            fputs(line, target);
+    }
+
+    if (source && fclose(source))
+    {
+        fclose(target);
+        return INTERNAL_ERROR;
+    }
+
+    if (print_settings(target, port, settings) | fclose(target))
+        return INTERNAL_ERROR;
+
+    if (rename(temporary, file) < 0)
+        return INTERNAL_ERROR;
+
+    return DONE;
+}
@@ -0,0 +1,1549 @@
+/*
+ * Emrom - ROM emulator software
+ * Copyright (c) 2016 rksdna
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include <string.h>
+#include <sys/uio.h>
+#include "serial.h"
+#include "device.h"
+#include "shadow.h"
+#include "errors.h"
+
+#define FRAME_HEAD_SIZE (1 + 2 * 2)
+#define FRAME_DATA_SIZE (2 * DEVICE_PAGE_SIZE)
+#define FRAME_TAIL_SIZE (1)
+#define FRAME_BOARD_SIZE (1 + 2)
+#define FRAME_SIZE (FRAME_HEAD_SIZE + FRAME_DATA_SIZE + FRAME_TAIL_SIZE)
+#define CALIBRATION_PROBES 16
+#define IDENTITY_SIZE 6
+
+#define CYCLE_TIME 1.0851e-6
+#define READ_OVERHEAD_CYCLES 20
+#define READ_BYTE_CYCLES 14
+#define WRITE_OVERHEAD_CYCLES 20
+#define WRITE_BYTE_CYCLES 15
+#define VERIFY_BYTE_CYCLES 26
+#define VERIFY_RETRY_LIMIT 3
+#define SCAN_OVERHEAD_CYCLES 30
+#define CHECK_BYTE_CYCLES 15
+#define CHECKSUM_BYTE_CYCLES 41
+#define FILL_BYTE_CYCLES 12
+#define FILL_REQUEST_SIZE 5
+#define FILL_REPLY_SIZE 2
+#define LINK_BYTE_TIME (10.0 / 57600)
+#define DEFAULT_TURNAROUND 0.016
+#define LOW_LATENCY_TURNAROUND 0.001
+#define SCAN_LIMIT 0x10000
+#define SHADOW_CHECK_SIZE 0x1000
+#define CRC_POLYNOMIAL 0xEDB88320
+
+struct step
+{
+    enum plan plan;
+    uint8_t value;
+    size_t count;
+    struct buffer runs[DEVICE_PAGE_SIZE / 2];
+    struct cost cost;
+};
+
+struct fill
+{
+    uint32_t address;
+    size_t size;
+    uint8_t value;
+};
+
+struct slot
+{
+    uint32_t address;
+    const uint8_t *data;
+    size_t size;
+    size_t length;
+    int retries;
+    char frame[FRAME_BOARD_SIZE + FRAME_SIZE];
+};
+
+struct device
+{
+    struct serial_port port;
+    progress_handler_t progress;
+    void *context;
+    size_t window;
+    size_t burst;
+    int hold;
+    int control;
+    struct stall stall;
+    struct identity identity;
+    size_t memory;
+    double turnaround;
+    int board;
+    struct shadow *shadow;
+    uint8_t page[DEVICE_PAGE_SIZE];
+    char frame[FRAME_BOARD_SIZE + FRAME_SIZE];
+    struct slot slots[DEVICE_WINDOW_LIMIT];
+    struct iovec vector[DEVICE_WINDOW_LIMIT];
+};
+
+static const struct identity legacy =
+{
+    0, DEVICE_PAGE_SIZE, DEVICE_READ_COMMAND | DEVICE_WRITE_COMMAND, DEVICE_MEMORY_SIZE, 1, 0
+};
+
+static const char digits[] = "0123456789ABCDEF";
+
+static const uint8_t nibbles[256] =
+{
+    ['0'] = 0x10, ['1'] = 0x11, ['2'] = 0x12, ['3'] = 0x13,
+    ['4'] = 0x14, ['5'] = 0x15, ['6'] = 0x16, ['7'] = 0x17,
+    ['8'] = 0x18, ['9'] = 0x19, ['A'] = 0x1A, ['B'] = 0x1B,
+    ['C'] = 0x1C, ['D'] = 0x1D, ['E'] = 0x1E, ['F'] = 0x1F,
+    ['a'] = 0x1A, ['b'] = 0x1B, ['c'] = 0x1C, ['d'] = 0x1D,
+    ['e'] = 0x1E, ['f'] = 0x1F
+};
+
+struct device *create_device(void)
+{
+    struct device *device = calloc(1, sizeof(struct device));
+
+    if (device)
+    {
+        init_serial_port(&device->port);
+        device->window = 1;
+        device->burst = DEVICE_PAGE_SIZE;
+        device->identity = legacy;
+        device->memory = legacy.memory;
+        device->board = DEVICE_NO_BOARD;
+    }
+
+    return device;
+}
+
+void destroy_device(struct device *device)
+{
+    if (device && device->port.fd >= 0)
+        close_serial_port(&device->port);
+
+    free(device);
+}
+
+void watch_device(struct device *device, progress_handler_t handler, void *context)
+{
+    device->progress = handler;
+    device->context = context;
+}
+
+static long hold_burst(struct device *device, int hold)
+{
+    int cycles = device->identity.commands & DEVICE_VERIFY_COMMAND ? VERIFY_BYTE_CYCLES : WRITE_BYTE_CYCLES;
+
+    if (!hold)
+        return DEVICE_PAGE_SIZE;
+
+    return (hold * 1e-6 / CYCLE_TIME - WRITE_OVERHEAD_CYCLES) / cycles;
+}
+
+static void size_burst(struct device *device)
+{
+    long burst = hold_burst(device, device->hold);
+
+    device->burst = burst < 1 ? 1 : burst < DEVICE_PAGE_SIZE ? burst : DEVICE_PAGE_SIZE;
+}
+
+int set_device_window(struct device *device, size_t window)
+{
+    if (window < 1 || window > DEVICE_WINDOW_LIMIT)
+        return INVALID_OPTIONS_ARGUMENT;
+
+    device->window = window < device->identity.queue ? window : device->identity.queue;
+    return DONE;
+}
+
+int set_device_latency(struct device *device, int latency, int *features)
+{
+    int result;
+
+    if ((result = tune_serial_port(&device->port, latency, device->port.timeout)))
+        return result;
+
+    if (features)
+        *features = device->port.features;
+
+    return DONE;
+}
+
+int set_device_timeout(struct device *device, int timeout)
+{
+    return tune_serial_port(&device->port, device->port.latency, timeout);
+}
+
+void get_device_settings(struct device *device, struct settings *settings)
+{
+    settings->window = device->window;
+    settings->latency = device->port.latency;
+    settings->timeout = device->port.timeout;
+    settings->identity = device->identity;
+}
+
+int set_device_settings(struct device *device, const struct settings *settings)
+{
+    int result;
+
+    if (settings->identity.protocol >= 0)
+    {
+        device->identity = settings->identity;
+        device->memory = settings->identity.memory < DEVICE_MEMORY_SIZE ? settings->identity.memory : DEVICE_MEMORY_SIZE;
+        size_burst(device);
+    }
+
+    if ((result = set_device_window(device, settings->window)))
+        return result;
+
+    if ((result = tune_serial_port(&device->port, settings->latency, settings->timeout)))
+        return result;
+
+    return DONE;
+}
+
+int set_device_geometry(struct device *device, size_t memory)
+{
+    if (!memory || memory % DEVICE_PAGE_SIZE || memory > device->identity.memory || memory > DEVICE_MEMORY_SIZE)
+        return INVALID_OPTIONS_ARGUMENT;
+
+    device->memory = memory;
+    return DONE;
+}
+
+size_t get_device_geometry(struct device *device)
+{
+    return device->memory;
+}
+
+int set_device_hold(struct device *device, int hold)
+{
+    long burst = hold_burst(device, hold);
+
+    if (burst < 1)
+        return INVALID_OPTIONS_ARGUMENT;
+
+    if (burst < DEVICE_PAGE_SIZE && !(device->identity.commands & DEVICE_PATCH_COMMAND))
+        return INVALID_OPTIONS_ARGUMENT;
+
+    device->hold = hold;
+    size_burst(device);
+    return DONE;
+}
+
+void set_device_control(struct device *device, int control)
+{
+    device->control = control;
+}
+
+void set_device_shadow(struct device *device, struct shadow *shadow)
+{
+    device->shadow = shadow;
+}
+
+int set_device_board(struct device *device, int board)
+{
+    if (board < DEVICE_NO_BOARD || (board >= DEVICE_BOARD_LIMIT && board != DEVICE_BROADCAST_BOARD))
+        return INVALID_OPTIONS_ARGUMENT;
+
+    device->board = board;
+    return DONE;
+}
+
+void get_device_stall(struct device *device, struct stall *stall)
+{
+    *stall = device->stall;
+    memset(&device->stall, 0, sizeof(struct stall));
+}
+
+static void stall(struct device *device, int cycles)
+{
+    double time = cycles * CYCLE_TIME;
+
+    device->stall.total += time;
+    device->stall.frames++;
+
+    if (time > device->stall.worst)
+        device->stall.worst = time;
+}
+
+static void progress(struct device *device, uint32_t address, size_t size)
+{
+    if (device->progress)
+        device->progress(device->context, address, size);
+}
+
+int open_device(struct device *device, const char *file)
+{
+    return open_serial_port(&device->port, file);
+}
+
+int close_device(struct device *device)
+{
+    return close_serial_port(&device->port);
+}
+
+static char *encode_byte(char *p, uint8_t value)
+{
+    *p++ = digits[value >> 4];
+    *p++ = digits[value & 0x0F];
+    return p;
+}
+
+static char *encode_head(struct device *device, char *p, char mode)
+{
+    if (device->board != DEVICE_NO_BOARD)
+    {
+        *p++ = '@';
+        p = encode_byte(p, device->board);
+    }
+
+    *p++ = mode;
+    return p;
+}
+
+static size_t encode_frame(struct device *device, char *frame, char mode, uint32_t address, const uint8_t *data, int count)
+{
+    char *p = encode_head(device, frame, mode);
+
+    p = encode_byte(p, address & 0xFF);
+    p = encode_byte(p, (address >> 8) & 0xFF);
+
+    while (count--)
+        p = encode_byte(p, *data++);
+
+    *p++ = '\n';
+    return p - frame;
+}
+
+static uint8_t decode_bytes(const char *p, uint8_t *data, int count)
+{
+    uint8_t valid = 0x10;
+
+    while (count--)
+    {
+        uint8_t high = nibbles[(uint8_t)*p++];
+        uint8_t low = nibbles[(uint8_t)*p++];
+
+        valid &= high & low;
+        *data++ = (high << 4) | (low & 0x0F);
+    }
+
+    return valid;
+}
+
+static int decode_reply(const char *frame, uint16_t *echo, uint8_t *data, int count)
+{
+    uint8_t head[2];
+    uint8_t valid = decode_bytes(frame + 1, head, 2) & decode_bytes(frame + FRAME_HEAD_SIZE, data, count);
+
+    if (!valid || frame[0] != ':' || frame[FRAME_HEAD_SIZE + 2 * count] != '\n')
+        return INVALID_DEVICE_REPLY;
+
+    *echo = head[1] << 8 | head[0];
+    return DONE;
+}
+
+static int decode_frame(const char *frame, uint32_t address, uint8_t *data, int count)
+{
+    int result;
+    uint16_t echo;
+
+    if ((result = decode_reply(frame, &echo, data, count)))
+        return result;
+
+    if (echo != (address & 0xFFFF))
+        return INVALID_DEVICE_REPLY;
+
+    return DONE;
+}
+
+static uint16_t sum_frame(uint32_t address, const uint8_t *data, size_t size)
+{
+    uint8_t low = address & 0xFF;
+    uint8_t high = (address >> 8) & 0xFF;
+
+    while (size--)
+    {
+        low += *data++;
+        high += low;
+    }
+
+    return high << 8 | low;
+}
+
+static int read_device_page(struct device *device, uint32_t address, uint8_t *data)
+{
+    int result;
+
+    if ((result = write_serial_port(&device->port, device->frame, encode_frame(device, device->frame, ':', address, 0, 0))))
+        return result;
+
+    if ((result = read_serial_port(&device->port, device->frame, FRAME_SIZE)))
+        return result;
+
+    if ((result = decode_frame(device->frame, address, data, DEVICE_PAGE_SIZE)))
+        return result;
+
+    if (device->shadow)
+        update_shadow(device->shadow, address, data, DEVICE_PAGE_SIZE);
+
+    stall(device, READ_OVERHEAD_CYCLES + READ_BYTE_CYCLES * DEVICE_PAGE_SIZE);
+    return DONE;
+}
+
+int read_device_memory(struct device *device, const struct buffer *buffer)
+{
+    uint32_t address = buffer->origin;
+    uint8_t *data = buffer->data;
+    size_t size = buffer->size;
+
+    while (size)
+    {
+        int result;
+        int offset = address % DEVICE_PAGE_SIZE;
+        int count = DEVICE_PAGE_SIZE - offset;
+
+        if (count > size)
+            count = size;
+
+        if ((result = read_device_page(device, address - offset, device->page)))
+            return result;
+
+        memcpy(data, device->page + offset, count);
+        progress(device, address, count);
+
+        address += count;
+        data += count;
+        size -= count;
+    }
+
+    return DONE;
+}
+
+static int query_device(struct device *device, char mode, const uint8_t *request, int count, uint8_t *reply, int size, int cycles)
+{
+    int result;
+    char *p = encode_head(device, device->frame, mode);
+
+    while (count--)
+        p = encode_byte(p, *request++);
+
+    *p++ = '\n';
+
+    if ((result = write_serial_port(&device->port, device->frame, p - device->frame)))
+        return result;
+
+    if ((result = poll_serial_port(&device->port, device->port.timeout + (int)(cycles * CYCLE_TIME * 1000))))
+        return result;
+
+    if ((result = read_serial_port(&device->port, device->frame, 1 + 2 * size + 1)))
+        return result;
+
+    if (!decode_bytes(device->frame + 1, reply, size) || device->frame[0] != ':' || device->frame[1 + 2 * size] != '\n')
+        return INVALID_DEVICE_REPLY;
+
+    stall(device, cycles);
+    return DONE;
+}
+
+static int drop_device_frames(struct device *device, size_t tail, size_t head, int result)
+{
+    while (device->shadow && tail < head)
+    {
+        struct slot *slot = &device->slots[tail++ % DEVICE_WINDOW_LIMIT];
+
+        forget_shadow(device->shadow, slot->address, slot->size);
+    }
+
+    return result;
+}
+
+static int broadcast_device_spans(struct device *device, const struct buffer *spans, size_t count, int repeat)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        uint32_t address = spans[i].origin;
+        const uint8_t *data = spans[i].data;
+        size_t size = spans[i].size;
+
+        if (device->shadow)
+            forget_shadow(device->shadow, address, size);
+
+        while (size)
+        {
+            int result;
+            int length = DEVICE_PAGE_SIZE - address % DEVICE_PAGE_SIZE;
+            int cycles;
+
+            if (length > size)
+                length = size;
+
+            if (length > device->burst)
+                length = device->burst;
+
+            cycles = WRITE_OVERHEAD_CYCLES + WRITE_BYTE_CYCLES * length;
+
+            if ((result = write_serial_port(&device->port, device->frame, encode_frame(device, device->frame, ':', address, data, length))))
+                return result;
+
+            if ((result = drain_serial_port(&device->port)))
+                return result;
+
+            if ((result = wait_serial_port(1 + (int)(cycles * CYCLE_TIME * 1000))))
+                return result;
+
+            stall(device, cycles);
+            progress(device, address, length);
+
+            address += length;
+            size -= length;
+
+            if (!repeat)
+                data += length;
+        }
+    }
+
+    return DONE;
+}
+
+static int send_device_spans(struct device *device, const struct buffer *spans, size_t count, int repeat)
+{
+    int verify = device->identity.commands & DEVICE_VERIFY_COMMAND;
+    uint32_t address = 0;
+    const uint8_t *data = 0;
+    size_t size = 0;
+    size_t next = 0;
+    size_t head = 0;
+    size_t tail = 0;
+
+    if (device->board == DEVICE_BROADCAST_BOARD)
+        return broadcast_device_spans(device, spans, count, repeat);
+
+    while (size || next < count || tail < head)
+    {
+        int result;
+        int frames = 0;
+        uint16_t echo;
+        struct slot *slot;
+
+        while ((size || next < count) && head - tail < device->window)
+        {
+            int length;
+
+            if (!size)
+            {
+                address = spans[next].origin;
+                data = spans[next].data;
+                size = spans[next++].size;
+                continue;
+            }
+
+            length = DEVICE_PAGE_SIZE - address % DEVICE_PAGE_SIZE;
+
+            if (length > size)
+                length = size;
+
+            if (length > device->burst)
+                length = device->burst;
+
+            slot = &device->slots[head++ % DEVICE_WINDOW_LIMIT];
+            slot->address = address;
+            slot->data = data;
+            slot->size = length;
+            slot->length = encode_frame(device, slot->frame, verify ? ';' : ':', address, data, length);
+            slot->retries = 0;
+
+            device->vector[frames].iov_base = slot->frame;
+            device->vector[frames].iov_len = slot->length;
+            frames++;
+
+            address += length;
+            size -= length;
+
+            if (!repeat)
+                data += length;
+        }
+
+        if (tail == head)
+            break;
+
+        if (frames && (result = write_vector_serial_port(&device->port, device->vector, frames)))
+            return drop_device_frames(device, tail, head, result);
+
+        if ((result = read_serial_port(&device->port, device->frame, FRAME_HEAD_SIZE + FRAME_TAIL_SIZE)))
+            return drop_device_frames(device, tail, head, result);
+
+        slot = &device->slots[tail % DEVICE_WINDOW_LIMIT];
+
+        if ((result = decode_reply(device->frame, &echo, 0, 0)))
+            return drop_device_frames(device, tail, head, result);
+
+        stall(device, WRITE_OVERHEAD_CYCLES + (verify ? VERIFY_BYTE_CYCLES : WRITE_BYTE_CYCLES) * slot->size);
+
+        if (echo != (verify ? sum_frame(slot->address, slot->data, slot->size) : slot->address & 0xFFFF))
+        {
+            struct slot *again = &device->slots[head % DEVICE_WINDOW_LIMIT];
+
+            if (!verify)
+                return drop_device_frames(device, tail, head, INVALID_DEVICE_REPLY);
+
+            if (slot->retries++ == VERIFY_RETRY_LIMIT)
+                return drop_device_frames(device, tail, head, DEVICE_MEMORY_MISMATCH);
+
+            if (again != slot)
+                *again = *slot;
+
+            head++;
+            tail++;
+
+            if ((result = write_serial_port(&device->port, again->frame, again->length)))
+                return drop_device_frames(device, tail, head, result);
+
+            continue;
+        }
+
+        if (device->shadow)
+            update_shadow(device->shadow, slot->address, slot->data, slot->size);
+
+        tail++;
+        progress(device, slot->address, slot->size);
+    }
+
+    return DONE;
+}
+
+static int send_device_frames(struct device *device, uint32_t address, const uint8_t *data, size_t size, int repeat)
+{
+    struct buffer span =
+    {
+        0, address, size, (void *)data
+    };
+
+    return send_device_spans(device, &span, 1, repeat);
+}
+
+static int write_device_pages(struct device *device, uint32_t address, const uint8_t *data, size_t size)
+{
+    while (size)
+    {
+        int result;
+        int offset = address % DEVICE_PAGE_SIZE;
+        size_t count = offset || size < DEVICE_PAGE_SIZE ? DEVICE_PAGE_SIZE - offset : size - size % DEVICE_PAGE_SIZE;
+
+        if (count > size)
+            count = size;
+
+        if (count < DEVICE_PAGE_SIZE)
+        {
+            if ((result = read_device_page(device, address - offset, device->page)))
+                return result;
+
+            memcpy(device->page + offset, data, count);
+
+            if ((result = send_device_frames(device, address - offset, device->page, DEVICE_PAGE_SIZE, 0)))
+                return result;
+        }
+        else
+        {
+            if ((result = send_device_frames(device, address, data, count, 0)))
+                return result;
+        }
+
+        address += count;
+        data += count;
+        size -= count;
+    }
+
+    return DONE;
+}
+
+static int control_target(struct device *device, int active)
+{
+    int line = device->control & (DEVICE_RTS_CONTROL | DEVICE_DTR_CONTROL);
+
+    return control_serial_port(&device->port, active && (line & DEVICE_RTS_CONTROL), active && (line & DEVICE_DTR_CONTROL));
+}
+
+static int send_device_span(struct device *device, const struct buffer *buffer)
+{
+    if (!(device->identity.commands & DEVICE_PATCH_COMMAND))
+        return write_device_pages(device, buffer->origin, buffer->data, buffer->size);
+
+    return send_device_frames(device, buffer->origin, buffer->data, buffer->size, 0);
+}
+
+static double turnaround(struct device *device)
+{
+    if (device->turnaround > 0)
+        return device->turnaround;
+
+    return device->port.latency ? LOW_LATENCY_TURNAROUND : DEFAULT_TURNAROUND;
+}
+
+static void count_device_link(struct device *device, size_t link, double waits, int cycles, struct cost *cost)
+{
+    cost->link += link;
+    cost->time += link * LINK_BYTE_TIME + waits * turnaround(device) + cycles * CYCLE_TIME;
+}
+
+static void count_device_frames(struct device *device, size_t size, struct cost *cost)
+{
+    size_t frames = (size + device->burst - 1) / device->burst;
+    int cycles = device->identity.commands & DEVICE_VERIFY_COMMAND ? VERIFY_BYTE_CYCLES : WRITE_BYTE_CYCLES;
+    size_t prefix = device->board != DEVICE_NO_BOARD ? FRAME_BOARD_SIZE : 0;
+
+    cost->frames += frames;
+    cost->bytes += size;
+
+    if (device->board == DEVICE_BROADCAST_BOARD)
+        count_device_link(device, frames * (prefix + FRAME_HEAD_SIZE + FRAME_TAIL_SIZE) + 2 * size, 0, frames * WRITE_OVERHEAD_CYCLES + WRITE_BYTE_CYCLES * size, cost);
+    else
+        count_device_link(device, frames * (prefix + 2 * (FRAME_HEAD_SIZE + FRAME_TAIL_SIZE)) + 2 * size, (double)frames / device->window, frames * WRITE_OVERHEAD_CYCLES + cycles * size, cost);
+}
+
+static void count_device_span(struct device *device, const struct buffer *buffer, struct cost *cost)
+{
+    uint32_t address = buffer->origin;
+    size_t size = buffer->size;
+
+    while (size)
+    {
+        size_t count = DEVICE_PAGE_SIZE - address % DEVICE_PAGE_SIZE;
+
+        if (count > size)
+            count = size;
+
+        if (!(device->identity.commands & DEVICE_PATCH_COMMAND) && count < DEVICE_PAGE_SIZE)
+        {
+            count_device_link(device, FRAME_HEAD_SIZE + FRAME_TAIL_SIZE + FRAME_SIZE, 1, READ_OVERHEAD_CYCLES + READ_BYTE_CYCLES * DEVICE_PAGE_SIZE, cost);
+            count_device_frames(device, DEVICE_PAGE_SIZE, cost);
+        }
+        else
+        {
+            count_device_frames(device, count, cost);
+        }
+
+        address += count;
+        size -= count;
+    }
+}
+
+static size_t scan_limit(struct device *device, int overhead, int cycles)
+{
+    long limit;
+
+    if (!device->hold)
+        return SCAN_LIMIT;
+
+    limit = (device->hold * 1e-6 / CYCLE_TIME - overhead) / cycles;
+    return limit < 1 ? 1 : limit < SCAN_LIMIT ? limit : SCAN_LIMIT;
+}
+
+static size_t fill_limit(struct device *device)
+{
+    return scan_limit(device, SCAN_OVERHEAD_CYCLES, FILL_BYTE_CYCLES);
+}
+
+static void count_device_fill(struct device *device, size_t size, struct cost *cost)
+{
+    size_t frames = (size + fill_limit(device) - 1) / fill_limit(device);
+
+    cost->frames += frames;
+    cost->bytes += size;
+    count_device_link(device, frames * (4 + 2 * FILL_REQUEST_SIZE + 2 * FILL_REPLY_SIZE), frames, frames * SCAN_OVERHEAD_CYCLES + FILL_BYTE_CYCLES * size, cost);
+}
+
+static void count_device_runs(struct device *device, const struct step *step, struct cost *cost)
+{
+    size_t i;
+
+    for (i = 0; i < step->count; i++)
+        count_device_frames(device, step->runs[i].size, cost);
+}
+
+static int fill_device_span(struct device *device, uint32_t address, size_t size, uint8_t value)
+{
+    memset(device->page, value, DEVICE_PAGE_SIZE);
+
+    while (size)
+    {
+        int result;
+        size_t count = size < fill_limit(device) ? size : fill_limit(device);
+        uint8_t request[FILL_REQUEST_SIZE] = {address & 0xFF, (address >> 8) & 0xFF, count & 0xFF, (count >> 8) & 0xFF, value};
+        uint8_t reply[FILL_REPLY_SIZE];
+        size_t i;
+
+        if ((result = query_device(device, '#', request, sizeof(request), reply, sizeof(reply), SCAN_OVERHEAD_CYCLES + FILL_BYTE_CYCLES * count)) == DONE && (reply[0] | reply[1] << 8) != ((address + count) & 0xFFFF))
+            result = INVALID_DEVICE_REPLY;
+
+        if (result)
+        {
+            if (device->shadow)
+                forget_shadow(device->shadow, address, count);
+
+            return result;
+        }
+
+        for (i = 0; device->shadow && i < count; i += DEVICE_PAGE_SIZE)
+            update_shadow(device->shadow, address + i, device->page, count - i < DEVICE_PAGE_SIZE ? count - i : DEVICE_PAGE_SIZE);
+
+        progress(device, address, count);
+
+        address += count;
+        size -= count;
+    }
+
+    return DONE;
+}
+
+static size_t find_device_runs(struct device *device, uint32_t address, const uint8_t *data, const uint8_t *base, size_t size, struct buffer *runs)
+{
+    double frame = 2 * (FRAME_HEAD_SIZE + FRAME_TAIL_SIZE) * LINK_BYTE_TIME + turnaround(device) / device->window;
+    size_t gap = frame / (2 * LINK_BYTE_TIME);
+    size_t count = 0;
+    size_t i = 0;
+
+    while (i < size)
+    {
+        size_t end = i;
+
+        if (data[i] == base[i])
+        {
+            i++;
+            continue;
+        }
+
+        while (end < size && data[end] != base[end])
+            end++;
+
+        if (count && address + i - runs[count - 1].origin - runs[count - 1].size <= gap)
+        {
+            runs[count - 1].size = address + end - runs[count - 1].origin;
+        }
+        else
+        {
+            runs[count].origin = address + i;
+            runs[count].size = end - i;
+            runs[count].data = (void *)(data + i);
+            count++;
+        }
+
+        i = end;
+    }
+
+    return count;
+}
+
+static void plan_device_page(struct device *device, uint32_t address, const uint8_t *data, size_t size, struct step *step)
+{
+    const struct shadow *shadow = device->shadow;
+    int known = shadow && address < DEVICE_MEMORY_SIZE && shadow->known[address / DEVICE_PAGE_SIZE];
+    int patch = device->identity.commands & DEVICE_PATCH_COMMAND;
+    struct buffer span =
+    {
+        0, address, size, (void *)data
+    };
+    struct step trial;
+
+    memset(step, 0, sizeof(struct step));
+    step->plan = PAGE_PLAN;
+    count_device_span(device, &span, &step->cost);
+
+    if (shadow && match_shadow(shadow, address, data, size))
+    {
+        memset(step, 0, sizeof(struct step));
+        step->plan = SKIP_PLAN;
+        return;
+    }
+
+    if (known && patch)
+    {
+        memset(&trial, 0, sizeof(struct step));
+        trial.plan = PATCH_PLAN;
+        trial.count = find_device_runs(device, address, data, shadow->data + address, size, trial.runs);
+        count_device_runs(device, &trial, &trial.cost);
+
+        if (trial.cost.time < step->cost.time)
+            *step = trial;
+    }
+
+    if ((device->identity.features & DEVICE_FILL_FEATURE) && device->board != DEVICE_BROADCAST_BOARD)
+    {
+        size_t histogram[256] = {0};
+        size_t i;
+
+        memset(&trial, 0, sizeof(struct step));
+        trial.plan = FILL_PLAN;
+
+        for (i = 0; i < size; i++)
+        {
+            if (++histogram[data[i]] > histogram[trial.value])
+                trial.value = data[i];
+        }
+
+        memset(device->page, trial.value, DEVICE_PAGE_SIZE);
+        trial.count = find_device_runs(device, address, data, device->page, size, trial.runs);
+        count_device_fill(device, size, &trial.cost);
+        count_device_runs(device, &trial, &trial.cost);
+
+        if ((patch || !trial.count) && trial.cost.time < step->cost.time)
+            *step = trial;
+    }
+}
+
+static int flush_device_span(struct device *device, struct buffer *span, struct cost *cost)
+{
+    int result = DONE;
+
+    if (span->size && cost)
+        count_device_span(device, span, cost);
+    else if (span->size)
+        result = send_device_span(device, span);
+
+    span->size = 0;
+    return result;
+}
+
+static int flush_device_fill(struct device *device, struct fill *fill, struct cost *cost)
+{
+    int result = DONE;
+
+    if (fill->size && cost)
+        count_device_fill(device, fill->size, cost);
+    else if (fill->size)
+        result = fill_device_span(device, fill->address, fill->size, fill->value);
+
+    fill->size = 0;
+    return result;
+}
+
+static int flush_device_runs(struct device *device, const struct step *step, struct cost *cost)
+{
+    if (cost)
+    {
+        count_device_runs(device, step, cost);
+        return DONE;
+    }
+
+    return send_device_spans(device, step->runs, step->count, 0);
+}
+
+static int write_device_span(struct device *device, const struct buffer *buffer, struct cost *cost)
+{
+    int result;
+    struct buffer span = *buffer;
+    struct fill fill = {0, 0, 0};
+    uint32_t address = buffer->origin;
+    const uint8_t *data = buffer->data;
+    size_t size = buffer->size;
+
+    span.size = 0;
+
+    while (size)
+    {
+        struct step step;
+        size_t count = DEVICE_PAGE_SIZE - address % DEVICE_PAGE_SIZE;
+
+        if (count > size)
+            count = size;
+
+        plan_device_page(device, address, data, count, &step);
+
+        if (cost)
+            cost->pages[step.plan]++;
+
+        if (step.plan != PAGE_PLAN && (result = flush_device_span(device, &span, cost)))
+            return result;
+
+        if (fill.size && (step.plan != FILL_PLAN || fill.address + fill.size != address || fill.value != step.value) && (result = flush_device_fill(device, &fill, cost)))
+            return result;
+
+        if (step.plan == PAGE_PLAN)
+        {
+            if (!span.size)
+            {
+                span.origin = address;
+                span.data = (void *)data;
+            }
+
+            span.size += count;
+        }
+
+        if (step.plan == FILL_PLAN)
+        {
+            if (!fill.size)
+            {
+                fill.address = address;
+                fill.value = step.value;
+            }
+
+            fill.size += count;
+        }
+
+        if (step.count && (result = flush_device_fill(device, &fill, cost)))
+            return result;
+
+        if (step.count && (result = flush_device_runs(device, &step, cost)))
+            return result;
+
+        address += count;
+        data += count;
+        size -= count;
+    }
+
+    if ((result = flush_device_fill(device, &fill, cost)))
+        return result;
+
+    return flush_device_span(device, &span, cost);
+}
+
+int begin_device_write(struct device *device)
+{
+    if (device->control & DEVICE_HOLD_CONTROL)
+        return control_target(device, 1);
+
+    return DONE;
+}
+
+int end_device_write(struct device *device, int result)
+{
+    int release;
+
+    if (!(device->control & (DEVICE_HOLD_CONTROL | DEVICE_RESET_CONTROL)))
+        return result;
+
+    if (!result && (device->control & DEVICE_RESET_CONTROL) && !(result = control_target(device, 1)))
+        result = wait_serial_port(DEVICE_RESET_TIME);
+
+    release = control_target(device, 0);
+    return result ? result : release;
+}
+
+int write_device_memory(struct device *device, const struct buffer *buffer)
+{
+    return write_device_span(device, buffer, 0);
+}
+
+void estimate_device_memory(struct device *device, const struct buffer *buffer, struct cost *plan, struct cost *naive)
+{
+    write_device_span(device, buffer, plan);
+    count_device_span(device, buffer, naive);
+    naive->pages[PAGE_PLAN] += (buffer->origin + buffer->size + DEVICE_PAGE_SIZE - 1) / DEVICE_PAGE_SIZE - buffer->origin / DEVICE_PAGE_SIZE;
+}
+
+int erase_device_memory(struct device *device, uint8_t value)
+{
+    if ((device->identity.features & DEVICE_FILL_FEATURE) && device->board != DEVICE_BROADCAST_BOARD)
+        return fill_device_span(device, 0, device->memory, value);
+
+    memset(device->page, value, DEVICE_PAGE_SIZE);
+    return send_device_frames(device, 0, device->page, device->memory, 1);
+}
+
+static uint32_t update_crc(uint32_t crc, const uint8_t *data, size_t size)
+{
+    crc = ~crc;
+
+    while (size--)
+    {
+        int bit;
+
+        crc ^= *data++;
+
+        for (bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (crc & 1 ? CRC_POLYNOMIAL : 0);
+    }
+
+    return ~crc;
+}
+
+int verify_device_memory(struct device *device, const struct buffer *buffer)
+{
+    uint32_t address = buffer->origin;
+    const uint8_t *data = buffer->data;
+    size_t size = buffer->size;
+
+    while (size)
+    {
+        int result;
+        int offset = address % DEVICE_PAGE_SIZE;
+        int count = DEVICE_PAGE_SIZE - offset;
+        uint32_t crc = 0;
+
+        if (device->identity.commands & DEVICE_CHECKSUM_COMMAND)
+        {
+            count = size < SCAN_LIMIT ? size : SCAN_LIMIT;
+
+            if ((result = checksum_device_memory(device, address, count, &crc)))
+                return result;
+
+            if (crc != update_crc(0, data, count))
+                return DEVICE_MEMORY_MISMATCH;
+        }
+        else
+        {
+            if (count > size)
+                count = size;
+
+            if ((result = read_device_page(device, address - offset, device->page)))
+                return result;
+
+            if (memcmp(device->page + offset, data, count))
+                return DEVICE_MEMORY_MISMATCH;
+
+            progress(device, address, count);
+        }
+
+        address += count;
+        data += count;
+        size -= count;
+    }
+
+    return DONE;
+}
+
+int verify_device_shadow(struct device *device, struct shadow *shadow)
+{
+    uint32_t address = 0;
+
+    while (address < DEVICE_MEMORY_SIZE)
+    {
+        int result;
+        size_t size = 0;
+        uint32_t crc = 0;
+
+        while (address + size < DEVICE_MEMORY_SIZE && size < SHADOW_CHECK_SIZE && shadow->known[(address + size) / DEVICE_PAGE_SIZE])
+            size += DEVICE_PAGE_SIZE;
+
+        if (!size)
+        {
+            address += DEVICE_PAGE_SIZE;
+            continue;
+        }
+
+        if ((result = checksum_device_memory(device, address, size, &crc)))
+            return result;
+
+        if (crc != update_crc(0, shadow->data + address, size))
+            forget_shadow(shadow, address, size);
+
+        address += size;
+    }
+
+    return DONE;
+}
+
+int check_device_memory(struct device *device, uint32_t address, size_t size, uint8_t value, uint32_t *mismatch)
+{
+    while (size)
+    {
+        int result;
+        int offset = address % DEVICE_PAGE_SIZE;
+        int count = DEVICE_PAGE_SIZE - offset;
+
+        if (device->identity.commands & DEVICE_CHECK_COMMAND)
+        {
+            uint8_t reply[3];
+            uint8_t request[5] = {address & 0xFF, (address >> 8) & 0xFF, 0, 0, value};
+            size_t limit = scan_limit(device, SCAN_OVERHEAD_CYCLES, CHECK_BYTE_CYCLES);
+
+            count = size < limit ? size : limit;
+            request[2] = count & 0xFF;
+            request[3] = (count >> 8) & 0xFF;
+
+            if ((result = query_device(device, '=', request, sizeof(request), reply, sizeof(reply), SCAN_OVERHEAD_CYCLES + CHECK_BYTE_CYCLES * count)))
+                return result;
+
+            if (reply[0])
+            {
+                *mismatch = (address & ~0xFFFF) | reply[1] | reply[2] << 8;
+                return DEVICE_MEMORY_NOT_BLANK;
+            }
+        }
+        else
+        {
+            int index;
+
+            if (count > size)
+                count = size;
+
+            if ((result = read_device_page(device, address - offset, device->page)))
+                return result;
+
+            for (index = 0; index < count; index++)
+            {
+                if (device->page[offset + index] != value)
+                {
+                    *mismatch = address + index;
+                    return DEVICE_MEMORY_NOT_BLANK;
+                }
+            }
+        }
+
+        progress(device, address, count);
+
+        address += count;
+        size -= count;
+    }
+
+    return DONE;
+}
+
+int checksum_device_memory(struct device *device, uint32_t address, size_t size, uint32_t *crc)
+{
+    while (size)
+    {
+        int result;
+        int offset = address % DEVICE_PAGE_SIZE;
+        int count = DEVICE_PAGE_SIZE - offset;
+
+        if (device->identity.commands & DEVICE_CHECKSUM_COMMAND)
+        {
+            uint8_t reply[4];
+            uint32_t state = ~*crc;
+            uint8_t request[8] = {address & 0xFF, (address >> 8) & 0xFF, 0, 0, state & 0xFF, (state >> 8) & 0xFF, (state >> 16) & 0xFF, state >> 24};
+            size_t limit = scan_limit(device, SCAN_OVERHEAD_CYCLES, CHECKSUM_BYTE_CYCLES);
+
+            count = size < limit ? size : limit;
+            request[2] = count & 0xFF;
+            request[3] = (count >> 8) & 0xFF;
+
+            if ((result = query_device(device, '%', request, sizeof(request), reply, sizeof(reply), SCAN_OVERHEAD_CYCLES + CHECKSUM_BYTE_CYCLES * count)))
+                return result;
+
+            *crc = ~(reply[0] | reply[1] << 8 | reply[2] << 16 | (uint32_t)reply[3] << 24);
+        }
+        else
+        {
+            if (count > size)
+                count = size;
+
+            if ((result = read_device_page(device, address - offset, device->page)))
+                return result;
+
+            *crc = update_crc(*crc, device->page + offset, count);
+        }
+
+        progress(device, address, count);
+
+        address += count;
+        size -= count;
+    }
+
+    return DONE;
+}
+
+int sample_device_memory(struct device *device, const struct buffer *buffer)
+{
+    uint32_t address = buffer->origin;
+    uint8_t *data = buffer->data;
+    size_t size = buffer->size;
+
+    while (size)
+    {
+        int result;
+        int offset = address % DEVICE_PAGE_SIZE;
+        int count = DEVICE_PAGE_SIZE - offset;
+
+        if (device->identity.commands & DEVICE_SAMPLE_COMMAND)
+        {
+            uint8_t request[3] = {address & 0xFF, (address >> 8) & 0xFF, 0};
+            size_t limit = scan_limit(device, READ_OVERHEAD_CYCLES, READ_BYTE_CYCLES);
+
+            count = size < DEVICE_PAGE_SIZE ? size : DEVICE_PAGE_SIZE;
+
+            if (count > limit)
+                count = limit;
+
+            request[2] = count;
+
+            if ((result = query_device(device, '&', request, sizeof(request), data, count, READ_OVERHEAD_CYCLES + READ_BYTE_CYCLES * count)))
+                return result;
+
+            if (device->shadow)
+                update_shadow(device->shadow, address, data, count);
+        }
+        else
+        {
+            if (count > size)
+                count = size;
+
+            if ((result = read_device_page(device, address - offset, device->page)))
+                return result;
+
+            memcpy(data, device->page + offset, count);
+        }
+
+        address += count;
+        data += count;
+        size -= count;
+    }
+
+    return DONE;
+}
+
+int identify_device(struct device *device, struct identity *identity)
+{
+    int result;
+    uint8_t data[IDENTITY_SIZE + 1];
+    char *frame = device->frame;
+    char *p;
+    int size;
+
+    p = encode_head(device, frame, '?');
+    *p++ = '\n';
+
+    if ((result = write_serial_port(&device->port, frame, p - frame)))
+        return result;
+
+    result = read_serial_port(&device->port, frame, 1 + 2 * IDENTITY_SIZE);
+
+    if (result == NO_DEVICE_REPLY)
+    {
+        device->identity = legacy;
+    }
+    else
+    {
+        if (result)
+            return result;
+
+        if (!decode_bytes(frame + 1, data, IDENTITY_SIZE) || frame[0] != ':')
+            return INVALID_DEVICE_REPLY;
+
+        size = data[0] >= DEVICE_FEATURE_PROTOCOL ? IDENTITY_SIZE + 1 : IDENTITY_SIZE;
+        data[IDENTITY_SIZE] = 0;
+
+        if ((result = read_serial_port(&device->port, frame + 1 + 2 * IDENTITY_SIZE, 2 * (size - IDENTITY_SIZE) + 1)))
+            return result;
+
+        if (!decode_bytes(frame + 1 + 2 * IDENTITY_SIZE, data + IDENTITY_SIZE, size - IDENTITY_SIZE) || frame[1 + 2 * size] != '\n')
+            return INVALID_DEVICE_REPLY;
+
+        device->identity.protocol = data[0];
+        device->identity.frame = data[1];
+        device->identity.commands = data[2];
+        device->identity.memory = (data[3] | data[4] << 8) * 0x100;
+        device->identity.queue = data[5];
+        device->identity.features = data[6];
+    }
+
+    if (device->window > device->identity.queue)
+        device->window = device->identity.queue;
+
+    device->memory = device->identity.memory < DEVICE_MEMORY_SIZE ? device->identity.memory : DEVICE_MEMORY_SIZE;
+    size_burst(device);
+    *identity = device->identity;
+    return DONE;
+}
+
+static double now(void)
+{
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+int probe_device(struct device *device, int count, struct probe *probe)
+{
+    int i;
+
+    probe->min = 0;
+    probe->average = 0;
+    probe->max = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        int result;
+        double time = now();
+
+        if ((result = read_device_page(device, 0, device->page)))
+            return result;
+
+        time = now() - time;
+        device->turnaround = time - (2 + 2 * 2 + FRAME_SIZE) * LINK_BYTE_TIME - (READ_OVERHEAD_CYCLES + READ_BYTE_CYCLES * DEVICE_PAGE_SIZE) * CYCLE_TIME;
+
+        if (!i || time < probe->min)
+            probe->min = time;
+
+        if (time > probe->max)
+            probe->max = time;
+
+        probe->average += time / count;
+    }
+
+    return DONE;
+}
+
+static int recover_device(struct device *device)
+{
+    int result;
+
+    if ((result = wait_serial_port(device->port.timeout)))
+        return result;
+
+    if ((result = flush_serial_port(&device->port)))
+        return result;
+
+    return DONE;
+}
+
+static void run_trial(struct device *device, struct trial *trial, const struct buffer *shadow)
+{
+    struct probe probe;
+    double time;
+
+    if (set_device_settings(device, &trial->settings))
+    {
+        trial->errors++;
+        return;
+    }
+
+    if (probe_device(device, CALIBRATION_PROBES, &probe))
+    {
+        trial->errors++;
+        recover_device(device);
+        return;
+    }
+
+    trial->latency = probe.average;
+    trial->worst = probe.max;
+
+    time = now();
+
+    if (send_device_span(device, shadow))
+    {
+        trial->errors++;
+        recover_device(device);
+        return;
+    }
+
+    trial->throughput = shadow->size / (now() - time);
+}
+
+static int restore_shadow(struct device *device, struct trial *trial, const struct buffer *shadow)
+{
+    int result;
+    struct settings settings = {1, 0, DEVICE_CALIBRATION_TIMEOUT, device->identity};
+
+    if ((result = set_device_settings(device, &settings)))
+        return result;
+
+    if (verify_device_memory(device, shadow) == DONE)
+        return DONE;
+
+    trial->errors++;
+
+    if ((result = recover_device(device)))
+        return result;
+
+    if ((result = send_device_span(device, shadow)))
+        return result;
+
+    return verify_device_memory(device, shadow);
+}
+
+static int rate_trial(const struct trial *trial, const struct trial *best)
+{
+    if (trial->errors)
+        return 0;
+
+    if (!best)
+        return 1;
+
+    if (trial->throughput != best->throughput)
+        return trial->throughput > best->throughput;
+
+    return trial->latency < best->latency;
+}
+
+static int calibrate_link(struct device *device, struct trial trials[], int *count, struct settings *best)
+{
+    static const size_t windows[] = {1, 2, 4, 8};
+
+    uint8_t data[CALIBRATION_PROBES * DEVICE_PAGE_SIZE];
+    struct buffer shadow = {0, 0, sizeof(data), data};
+    struct trial *choice = 0;
+    int latency;
+    int result;
+    int i;
+
+    *count = 0;
+    get_device_settings(device, best);
+
+    if ((result = read_device_memory(device, &shadow)))
+        return result;
+
+    for (latency = 0; latency < 2; latency++)
+    {
+        for (i = 0; i < sizeof(windows) / sizeof(windows[0]); i++)
+        {
+            struct trial *trial;
+
+            if (windows[i] > device->identity.queue)
+                continue;
+
+            trial = &trials[(*count)++];
+
+            memset(trial, 0, sizeof(struct trial));
+            trial->settings.window = windows[i];
+            trial->settings.latency = latency;
+            trial->settings.timeout = DEVICE_CALIBRATION_TIMEOUT;
+            trial->settings.identity = device->identity;
+
+            run_trial(device, trial, &shadow);
+
+            if ((result = restore_shadow(device, trial, &shadow)))
+                return result;
+
+            if (rate_trial(trial, choice))
+                choice = trial;
+        }
+    }
+
+    if (!choice)
+        return NO_DEVICE_REPLY;
+
+    *best = choice->settings;
+    best->timeout = 4e3 * (choice->worst + best->window * DEVICE_PAGE_SIZE / choice->throughput);
+    best->timeout = best->timeout < 100 ? 100 : (best->timeout + 99) / 100 * 100;
+
+    return set_device_settings(device, best);
+}
+
+int calibrate_device(struct device *device, struct trial trials[], int *count, struct settings *best)
+{
+    struct shadow *shadow = device->shadow;
+    int result;
+
+    device->shadow = 0;
+    result = calibrate_link(device, trials, count, best);
+    device->shadow = shadow;
+    return result;
+}
@@ -0,0 +1,160 @@
+/*
+ * Emrom - ROM emulator software
+ * Copyright (c) 2016 rksdna
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef DEVICE_H
+#define DEVICE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "buffer.h"
+
+#define DEVICE_MEMORY_SIZE 0x10000
+#define DEVICE_PAGE_SIZE 0x40
+#define DEVICE_WINDOW_LIMIT 16
+#define DEVICE_TRIAL_LIMIT 8
+#define DEVICE_CALIBRATION_TIMEOUT 500
+
+#define DEVICE_READ_COMMAND 0x01
+#define DEVICE_WRITE_COMMAND 0x02
+#define DEVICE_PATCH_COMMAND 0x04
+#define DEVICE_IDENTIFY_COMMAND 0x08
+#define DEVICE_CHECK_COMMAND 0x10
+#define DEVICE_CHECKSUM_COMMAND 0x20
+#define DEVICE_VERIFY_COMMAND 0x40
+#define DEVICE_SAMPLE_COMMAND 0x80
+
+#define DEVICE_FILL_FEATURE 0x01
+#define DEVICE_CHAIN_FEATURE 0x02
+
+#define DEVICE_FEATURE_PROTOCOL 2
+#define DEVICE_BOARD_PROTOCOL 3
+
+#define DEVICE_NO_BOARD -1
+#define DEVICE_BOARD_LIMIT 0xFE
+#define DEVICE_BROADCAST_BOARD 0xFF
+
+#define DEVICE_RTS_CONTROL 0x01
+#define DEVICE_DTR_CONTROL 0x02
+#define DEVICE_HOLD_CONTROL 0x04
+#define DEVICE_RESET_CONTROL 0x08
+#define DEVICE_RESET_TIME 50
+
+struct device;
+struct shadow;
+
+struct identity
+{
+    int protocol;
+    size_t frame;
+    int commands;
+    size_t memory;
+    size_t queue;
+    int features;
+};
+
+struct settings
+{
+    size_t window;
+    int latency;
+    int timeout;
+    struct identity identity;
+};
+
+struct trial
+{
+    struct settings settings;
+    double latency;
+    double worst;
+    double throughput;
+    int errors;
+};
+
+struct stall
+{
+    double total;
+    double worst;
+    size_t frames;
+};
+
+struct probe
+{
+    double min;
+    double average;
+    double max;
+};
+
+enum plan
+{
+    SKIP_PLAN,
+    FILL_PLAN,
+    PATCH_PLAN,
+    PAGE_PLAN,
+    PLAN_COUNT
+};
+
+struct cost
+{
+    size_t frames;
+    size_t bytes;
+    size_t link;
+    double time;
+    size_t pages[PLAN_COUNT];
+};
+
+typedef void (* progress_handler_t)(void *context, uint32_t address, size_t size);
+
+struct device *create_device(void);
+void destroy_device(struct device *device);
+void watch_device(struct device *device, progress_handler_t handler, void *context);
+int set_device_window(struct device *device, size_t window);
+int set_device_latency(struct device *device, int latency, int *features);
+int set_device_timeout(struct device *device, int timeout);
+int set_device_hold(struct device *device, int hold);
+void set_device_control(struct device *device, int control);
+void get_device_stall(struct device *device, struct stall *stall);
+void get_device_settings(struct device *device, struct settings *settings);
+int set_device_settings(struct device *device, const struct settings *settings);
+void set_device_shadow(struct device *device, struct shadow *shadow);
+int set_device_board(struct device *device, int board);
+int set_device_geometry(struct device *device, size_t memory);
+size_t get_device_geometry(struct device *device);
+
+int open_device(struct device *device, const char *file);
+int close_device(struct device *device);
+
+int read_device_memory(struct device *device, const struct buffer *buffer);
+int begin_device_write(struct device *device);
+int end_device_write(struct device *device, int result);
+int write_device_memory(struct device *device, const struct buffer *buffer);
+void estimate_device_memory(struct device *device, const struct buffer *buffer, struct cost *plan, struct cost *naive);
+int erase_device_memory(struct device *device, uint8_t value);
+int verify_device_memory(struct device *device, const struct buffer *buffer);
+int verify_device_shadow(struct device *device, struct shadow *shadow);
+int check_device_memory(struct device *device, uint32_t address, size_t size, uint8_t value, uint32_t *mismatch);
+int checksum_device_memory(struct device *device, uint32_t address, size_t size, uint32_t *crc);
+int sample_device_memory(struct device *device, const struct buffer *buffer);
+int identify_device(struct device *device, struct identity *identity);
+int probe_device(struct device *device, int count, struct probe *probe);
+int calibrate_device(struct device *device, struct trial trials[], int *count, struct settings *best);
+
+#endif
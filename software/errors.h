@@ -34,7 +34,12 @@ enum
     NO_DEVICE_REPLY,
     INVALID_DEVICE_REPLY,
     INVALID_FILE_CONTENT,
-    INVALID_FILE_CHECKSUM
+    INVALID_FILE_CHECKSUM,
+    DEVICE_MEMORY_MISMATCH,
+    OVERLAPPING_FILE_CONTENT,
+    MISSING_SETTINGS,
+    DEVICE_MEMORY_NOT_BLANK,
+    UNCHAINED_DEVICE_FIRMWARE
 };
 
 #endif
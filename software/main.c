@@ -22,214 +22,1771 @@
  */
 
 #include <stdio.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/stat.h>
 #include "options.h"
+#include "script.h"
+#include "config.h"
 #include "serial.h"
+#include "device.h"
+#include "shadow.h"
+#include "scramble.h"
 #include "buffer.h"
 #include "errors.h"
 
 #define VERSION 0
-#define MEMORY_SIZE 0x10000
-#define PAGE_SIZE 0x40
+#define MEMORY_SIZE DEVICE_MEMORY_SIZE
+#define PAGE_SIZE DEVICE_PAGE_SIZE
+#define IMAGE_LIMIT 8
+#define BOARD_LIMIT 8
 
-#define FRAME_HEAD_SIZE (1 + 2 * 2)
-#define FRAME_DATA_SIZE (2 * PAGE_SIZE)
-#define FRAME_TAIL_SIZE (1)
+struct region
+{
+    uint32_t base;
+    size_t size;
+    uint32_t offset;
+};
+
+struct board
+{
+    int id;
+    uint32_t base;
+    uint8_t data[MEMORY_SIZE];
+    uint8_t mask[MEMORY_SIZE];
+};
+
+struct image
+{
+    char *file;
+    struct timespec time;
+    off_t size;
+    struct region region;
+    struct buffer buffer;
+    uint8_t data[MEMORY_SIZE];
+    uint8_t mask[MEMORY_SIZE];
+};
 
+static struct device *device;
 static uint8_t memory[MEMORY_SIZE];
-static char frame[FRAME_HEAD_SIZE + FRAME_DATA_SIZE + FRAME_TAIL_SIZE];
+static uint8_t coverage[MEMORY_SIZE];
+static uint8_t sent[MEMORY_SIZE / PAGE_SIZE];
+static uint8_t wired[MEMORY_SIZE];
+static uint8_t wired_coverage[MEMORY_SIZE];
+static enum conflict conflict = REPLACE_CONFLICT;
+static struct image *images[IMAGE_LIMIT];
+static struct board boards[BOARD_LIMIT];
+static struct region region;
+static struct shadow shadow;
+static struct scramble scramble;
+static struct cost cost;
+static struct cost naive;
+static char shadow_file[PATH_MAX];
+static char config[PATH_MAX];
+static char port[PATH_MAX];
+static int image_index;
+static int board_count;
+static int board = DEVICE_NO_BOARD;
+static int fill = -1;
+static volatile sig_atomic_t interrupted;
+static int scrambled;
+static int live;
+static int dry;
+
+static void progress(void *context, uint32_t address, size_t size)
+{
+    fprintf(stdout, ".");
+}
+
+static int load_image(struct buffer *buffer, const char *file)
+{
+    int result;
+    int i;
+    struct stat status;
+    struct image *image;
+
+    if (stat(file, &status) < 0)
+        return INTERNAL_ERROR;
+
+    for (i = 0; i < IMAGE_LIMIT; i++)
+    {
+        image = images[i];
+
+        if (image && image->file && !strcmp(image->file, file) && image->size == status.st_size &&
+            image->time.tv_sec == status.st_mtim.tv_sec && image->time.tv_nsec == status.st_mtim.tv_nsec &&
+            !memcmp(&image->region, &region, sizeof(struct region)))
+        {
+            *buffer = image->buffer;
+            return DONE;
+        }
+    }
+
+    image = images[image_index];
+
+    if (!image && !(image = malloc(sizeof(struct image))))
+        return INTERNAL_ERROR;
+
+    images[image_index] = image;
+    image_index = (image_index + 1) % IMAGE_LIMIT;
+
+    free(image->file);
+    memset(image, 0, sizeof(struct image));
+
+    image->buffer.data = image->data;
+    image->buffer.mask = image->mask;
+    image->region = region;
+
+    if (region.size)
+    {
+        image->buffer.origin = region.base;
+        image->buffer.size = region.size;
+
+        if ((result = extract_file_buffer(&image->buffer, file)))
+            return result;
+
+        image->buffer.origin = image->buffer.origin - region.base + region.offset;
+    }
+    else
+    {
+        image->buffer.size = MEMORY_SIZE;
+
+        if ((result = load_file_buffer(&image->buffer, file)))
+            return result;
+    }
+
+    if (!(image->file = strdup(file)))
+        return INTERNAL_ERROR;
+
+    image->time = status.st_mtim;
+    image->size = status.st_size;
+    *buffer = image->buffer;
+    return DONE;
+}
+
+static void free_images(void)
+{
+    int i;
+
+    for (i = 0; i < IMAGE_LIMIT; i++)
+    {
+        if (images[i])
+            free(images[i]->file);
+
+        free(images[i]);
+    }
+}
+
+static int scramble_image(struct buffer *buffer)
+{
+    int result;
+    struct buffer target =
+    {
+        0, 0, get_device_geometry(device), wired, wired_coverage
+    };
+
+    if (!scrambled)
+        return DONE;
+
+    clear_buffer(&target, 0xFF);
+    memset(wired_coverage, 0, sizeof(wired_coverage));
+
+    if ((result = scramble_buffer(&scramble, buffer, &target, 0)))
+        return result;
+
+    *buffer = target;
+    return DONE;
+}
+
+static int read_image(struct buffer *buffer)
+{
+    int result;
+    struct buffer source =
+    {
+        0, 0, buffer->size, wired
+    };
+
+    if (!scrambled)
+        return read_device_memory(device, buffer);
+
+    if ((result = read_device_memory(device, &source)))
+        return result;
+
+    return scramble_buffer(&scramble, &source, buffer, 1);
+}
+
+static int compose_image(struct buffer *buffer, const char *file)
+{
+    int result;
+    struct buffer source;
+
+    if ((result = load_image(&source, file)))
+        return result;
+
+    buffer->origin = 0;
+    buffer->size = MEMORY_SIZE;
+    buffer->data = memory;
+    buffer->mask = coverage;
+
+    clear_buffer(buffer, 0xFF);
+    memset(coverage, 0, sizeof(coverage));
+
+    if ((result = merge_buffer(buffer, &source, 0, REPLACE_CONFLICT)))
+        return result;
+
+    if ((result = fold_buffer(buffer, get_device_geometry(device))))
+        return result;
+
+    return scramble_image(buffer);
+}
+
+static int store_shadow(void)
+{
+    int result = DONE;
+
+    if (*shadow_file)
+        result = save_shadow(&shadow, shadow_file);
+
+    set_device_shadow(device, 0);
+    *shadow_file = 0;
+    return result;
+}
+
+static void print_settings(const struct settings *settings)
+{
+    fprintf(stdout, " [protocol %d, window %zu, latency %s, timeout %d ms]", settings->identity.protocol, settings->window, settings->latency ? "on" : "off", settings->timeout);
+}
+
+static int identify(struct settings *settings)
+{
+    int result;
+
+    if ((result = identify_device(device, &settings->identity)))
+        return result;
+
+    if (settings->window > settings->identity.queue)
+        settings->window = settings->identity.queue;
+
+    if (*config && (result = save_settings(config, port, settings)))
+        return result;
+
+    return DONE;
+}
 
 static int connect_device(const char *file)
 {
     int result;
+    struct settings settings;
 
     fprintf(stdout, TTY_NONE "Connect \"%s\"...", file);
 
-    if ((result = open_serial_port(file)))
+    if ((result = store_shadow()))
+        return result;
+
+    if ((result = open_device(device, file)))
+        return result;
+
+    strncpy(port, file, sizeof(port) - 1);
+    get_device_settings(device, &settings);
+    settings.identity.protocol = -1;
+
+    result = *config ? load_settings(config, port, &settings) : MISSING_SETTINGS;
+
+    if (result && result != MISSING_SETTINGS)
         return result;
 
+    if (result == MISSING_SETTINGS)
+        settings.window = DEVICE_WINDOW_LIMIT;
+
+    if (settings.identity.protocol < 0 && (result = identify(&settings)))
+        return result;
+
+    if ((result = set_device_settings(device, &settings)))
+        return result;
+
+    get_device_settings(device, &settings);
+    print_settings(&settings);
     return DONE;
 }
 
-static int read_device_memory(const struct buffer *buffer)
+static int identify_device_again(void)
 {
-    uint32_t address = buffer->origin;
-    uint8_t *data = buffer->data;
-    size_t size = buffer->size;
+    int result;
+    struct settings settings;
 
-    while (size)
-    {
-        int result;
-        int count = PAGE_SIZE;
-        char *p = frame;
+    fprintf(stdout, TTY_NONE "Identifying...");
 
-        p += sprintf(p, ":%.2X%.2X", address & 0xFF, (address >> 8) & 0xFF);
-        address += PAGE_SIZE;
+    get_device_settings(device, &settings);
 
-        sprintf(p, "\n");
+    if ((result = identify(&settings)))
+        return result;
 
-        if ((result = write_serial_port(frame, FRAME_HEAD_SIZE + FRAME_TAIL_SIZE)))
-            return result;
+    fprintf(stdout, " [protocol %d, frame %zu, commands 0x%.2X, memory %zu, queue %zu, features 0x%.2X]", settings.identity.protocol,
+        settings.identity.frame, settings.identity.commands, settings.identity.memory, settings.identity.queue, settings.identity.features);
 
-        if ((result = read_serial_port(frame, FRAME_HEAD_SIZE + FRAME_DATA_SIZE + FRAME_TAIL_SIZE)))
-            return result;
+    return DONE;
+}
 
-        while (count--)
-        {
-            sscanf(p, "%2hhX", data++);
-            p += 2;
-        }
+static int calibrate_device_link(void)
+{
+    int result;
+    int count;
+    int i;
+    struct settings settings;
+    struct trial trials[DEVICE_TRIAL_LIMIT];
+
+    fprintf(stdout, TTY_NONE "Calibrating...");
+
+    result = calibrate_device(device, trials, &count, &settings);
+
+    fprintf(stdout, "\n");
+
+    for (i = 0; i < count; i++)
+    {
+        fprintf(stdout, TTY_NONE "\twindow %zu, latency %s:", trials[i].settings.window, trials[i].settings.latency ? "on" : "off");
 
-        size -= PAGE_SIZE;
-        fprintf(stdout, ".");
+        if (trials[i].errors)
+            fprintf(stdout, " %d errors\n", trials[i].errors);
+        else
+            fprintf(stdout, " %.2f ms round trip, %.0f B/s\n", 1e3 * trials[i].latency, trials[i].throughput);
     }
 
+    if (result)
+        return result;
+
+    fprintf(stdout, TTY_NONE "Selected");
+    print_settings(&settings);
+
+    if (*config && (result = save_settings(config, port, &settings)))
+        return result;
+
+    return DONE;
+}
+
+static int timeout_device(const char *argument)
+{
+    int result;
+    char *p;
+    long timeout = strtol(argument, &p, 0);
+
+    fprintf(stdout, TTY_NONE "Setting timeout %s ms...", argument);
+
+    if (*p)
+        return INVALID_OPTIONS_ARGUMENT;
+
+    if ((result = set_device_timeout(device, timeout)))
+        return result;
+
     return DONE;
 }
 
+static void report_stall(void)
+{
+    struct stall stall;
+
+    get_device_stall(device, &stall);
+
+    if (live)
+        fprintf(stdout, " [%zu frames, target stall %.0f us total, %.0f us worst]", stall.frames, 1e6 * stall.total, 1e6 * stall.worst);
+}
+
+static void trim(struct buffer *buffer)
+{
+    if (fill >= 0)
+    {
+        trim_buffer(buffer, fill);
+
+        if (buffer->size)
+            fprintf(stdout, " [0x%.4X-0x%.4X]", buffer->origin, (uint32_t)(buffer->origin + buffer->size - 1));
+    }
+}
+
 static int read_device(const char *file)
 {
     int result;
     struct buffer buffer =
     {
-        0, 0, MEMORY_SIZE, memory
+        0, 0, get_device_geometry(device), memory
     };
 
     fprintf(stdout, TTY_NONE "Reading to \"%s\"...", file);
 
-    if ((result = read_device_memory(&buffer)))
+    if ((result = read_image(&buffer)))
         return result;
 
+    trim(&buffer);
+
     if ((result = save_file_buffer(&buffer, file)))
         return result;
 
     return DONE;
 }
 
-static int write_device_memory(const struct buffer *buffer)
+static int read_device_binary(const char *file)
+{
+    int result;
+    struct buffer buffer =
+    {
+        0, 0, get_device_geometry(device), 0
+    };
+    struct buffer region;
+
+    fprintf(stdout, TTY_NONE "Reading to binary \"%s\"...", file);
+
+    if ((result = map_file_buffer(&buffer, file)))
+        return result;
+
+    if ((result = read_image(&buffer)))
+    {
+        unmap_file_buffer(&buffer, 0, file);
+        return result;
+    }
+
+    region = buffer;
+    trim(&region);
+
+    if ((result = unmap_file_buffer(&buffer, &region, file)))
+        return result;
+
+    return DONE;
+}
+
+static int trim_device(const char *argument)
+{
+    char *p;
+
+    fprintf(stdout, TTY_NONE "Setting trim \"%s\"...", argument);
+
+    if (!strcmp(argument, "off"))
+    {
+        fill = -1;
+        return DONE;
+    }
+
+    fill = strtoul(argument, &p, 0);
+
+    if (*p || fill > 0xFF)
+        return INVALID_OPTIONS_ARGUMENT;
+
+    return DONE;
+}
+
+typedef int (* span_handler_t)(struct device *device, const struct buffer *buffer);
+
+static int process_spans(struct buffer *buffer, span_handler_t handler)
 {
-    uint32_t address = buffer->origin;
+    uint32_t origin = buffer->origin;
     uint8_t *data = buffer->data;
+    uint8_t *mask = buffer->mask;
     size_t size = buffer->size;
 
     while (size)
     {
         int result;
-        int count = PAGE_SIZE;
-        char *p = frame;
-
-        p += sprintf(p, ":%.2X%.2X", address & 0xFF, (address >> 8) & 0xFF);
-        address += PAGE_SIZE;
-
-        while (count--)
-            p += sprintf(p, "%.2X", *data++);
+        struct buffer span =
+        {
+            0, origin, 0, data
+        };
 
-        sprintf(p, "\n");
+        while (span.size < size && mask[span.size])
+            span.size++;
 
-        if ((result = write_serial_port(frame, FRAME_HEAD_SIZE + FRAME_DATA_SIZE + FRAME_TAIL_SIZE)))
+        if (span.size && (result = handler(device, &span)))
             return result;
 
-        if ((result = read_serial_port(frame, FRAME_HEAD_SIZE + FRAME_TAIL_SIZE)))
-            return result;
+        if (span.size < size)
+            span.size++;
 
-        size -= PAGE_SIZE;
-        fprintf(stdout, ".");
+        origin += span.size;
+        data += span.size;
+        mask += span.size;
+        size -= span.size;
     }
 
     return DONE;
 }
 
-static uint32_t arrange(uint32_t value)
+static void report_plan(void)
+{
+    fprintf(stdout, " [skip %zu, fill %zu, patch %zu, raw %zu pages, %zu frames, %zu bytes on link, %.0f ms, naive %zu frames, %zu bytes on link, %.0f ms]",
+        cost.pages[SKIP_PLAN], cost.pages[FILL_PLAN], cost.pages[PATCH_PLAN], cost.pages[PAGE_PLAN], cost.frames, cost.link, 1e3 * cost.time, naive.frames, naive.link, 1e3 * naive.time);
+}
+
+static int estimate_span(struct device *device, const struct buffer *buffer)
+{
+    estimate_device_memory(device, buffer, &cost, &naive);
+    return DONE;
+}
+
+static int write_spans(struct buffer *buffer)
 {
-    return (value / PAGE_SIZE) * PAGE_SIZE;
+    int result;
+
+    if (!dry)
+        return process_spans(buffer, write_device_memory);
+
+    memset(&cost, 0, sizeof(struct cost));
+    memset(&naive, 0, sizeof(struct cost));
+
+    if ((result = process_spans(buffer, estimate_span)))
+        return result;
+
+    report_plan();
+    return DONE;
 }
 
-static int write_device(const char *file)
+static int write_held_spans(struct buffer *buffer)
 {
     int result;
-    uint32_t begin;
-    uint32_t end;
+
+    if (dry)
+        return write_spans(buffer);
+
+    if ((result = begin_device_write(device)))
+        return result;
+
+    return end_device_write(device, write_spans(buffer));
+}
+
+static int send_page(uint32_t page)
+{
     struct buffer buffer =
     {
-        0, 0, MEMORY_SIZE, memory
+        0, page * PAGE_SIZE, PAGE_SIZE, memory + page * PAGE_SIZE
     };
 
-    fprintf(stdout, TTY_NONE "Writing from \"%s\"...", file);
+    sent[page] = 1;
 
-    if ((result = load_file_buffer(&buffer, file)))
-        return result;
+    if (dry)
+    {
+        estimate_device_memory(device, &buffer, &cost, &naive);
+        return DONE;
+    }
+
+    return write_device_memory(device, &buffer);
+}
 
-    begin = arrange(buffer.origin);
-    end = arrange(buffer.origin + buffer.size + PAGE_SIZE - 1);
+static int send_complete_pages(void *context, uint32_t address, size_t size)
+{
+    uint32_t page;
+    int result;
 
-    buffer.origin = begin;
-    buffer.size = end - begin;
+    if (scrambled)
+        return DONE;
 
-    if ((result = write_device_memory(&buffer)))
-        return result;
+    for (page = address / PAGE_SIZE; page <= (address + size - 1) / PAGE_SIZE && page < get_device_geometry(device) / PAGE_SIZE; page++)
+    {
+        if (sent[page])
+            sent[page] = 2;
+        else if (!memchr(coverage + page * PAGE_SIZE, 0, PAGE_SIZE) && (result = send_page(page)))
+            return result;
+    }
 
     return DONE;
 }
 
-static int erase_device(const char *data)
+static int fold_record(void *context, uint32_t address, size_t size)
 {
+    size_t geometry = get_device_geometry(device);
+    uint32_t first = address % geometry;
+    uint32_t mirror;
+    uint32_t i;
     int result;
-    struct buffer buffer =
+
+    for (i = address; i < address + size && i < MEMORY_SIZE; i++)
     {
-        0, 0, MEMORY_SIZE, memory
-    };
+        for (mirror = i % geometry; mirror < MEMORY_SIZE; mirror += geometry)
+        {
+            if (mirror != i && coverage[mirror] && memory[mirror] != memory[i])
+                return OVERLAPPING_FILE_CONTENT;
+        }
 
-    fprintf(stdout, TTY_NONE "Erasing...");
+        memory[i % geometry] = memory[i];
+        coverage[i % geometry] = 1;
+    }
 
-    clear_buffer(&buffer, 0xFF);
+    if (first + size > geometry)
+    {
+        if ((result = send_complete_pages(context, first, geometry - first)))
+            return result;
 
-    if ((result = write_device_memory(&buffer)))
-        return result;
+        size -= geometry - first;
+        first = 0;
+    }
 
-    return DONE;
+    return send_complete_pages(context, first, size);
 }
 
-static int disconnect_device(void)
+static int feed_binary(FILE *stream)
 {
+    size_t limit = get_device_geometry(device);
+    size_t size = 0;
+    size_t count;
     int result;
 
-    fprintf(stdout, TTY_NONE "Disconnecting...");
+    while (size < limit && (count = fread(memory + size, 1, PAGE_SIZE, stream)))
+    {
+        memset(coverage + size, 1, count);
 
-    if ((result = close_serial_port()))
-        return result;
+        if ((result = send_complete_pages(0, size, count)))
+            return result;
+
+        size += count;
+    }
+
+    if (ferror(stream))
+        return INTERNAL_ERROR;
+
+    if (size == limit && getc(stream) != EOF)
+        return INVALID_FILE_CONTENT;
 
     return DONE;
 }
 
-int main(int argc, char* argv[])
+static int write_stream(const char *file)
 {
-    static const struct option options[] =
+    int result;
+    uint32_t page;
+    FILE *stream = strcmp(file, "-") ? fopen(file, "rb") : stdin;
+    struct buffer buffer =
     {
-        {JOINT_OPTION, "c", "connect", "Open serial port and connect to device", connect_device},
-        {JOINT_OPTION, "r", "read", "Read data from device memory to file", read_device},
-        {JOINT_OPTION, "w", "write", "Write data from file to device memory", write_device},
-        {PLAIN_OPTION, "e", "erase", "Erase device memory", erase_device},
-        {PLAIN_OPTION, "d", "disconnect", "Disconnect device and close serial port", disconnect_device},
-        {USAGE_OPTION, "h", "help", "Print this help", usage_options},
-        {OTHER_OPTION}
+        0, 0, MEMORY_SIZE, memory, coverage
     };
 
-    static const struct error errors[] =
-    {
-        {INVALID_FILE_CHECKSUM, "Invalid checksum of file"},
-        {INVALID_FILE_CONTENT, "Invalid device memory location or invalid record in file"},
-        {INVALID_DEVICE_REPLY, "Invalid reply from device bootloader"},
-        {NO_DEVICE_REPLY, "No reply from device bootloader"},
-        {SERIAL_PORT_ALREADY_OPEN, "Serial port already open"},
-        {INTERNAL_ERROR, "Internal error"},
-        {INVALID_OPTIONS_ARGUMENT, "Invalid actual parameter"},
-        {INVALID_OPTION, "Invalid option"},
-        {DONE, "No errors, all done"},
-    };
+    if (!stream)
+        return INTERNAL_ERROR;
 
-    static char stdout_buffer[256];
-    setvbuf(stdout, stdout_buffer, _IOLBF, sizeof(stdout_buffer));
-    fprintf(stdout, TTY_NONE "Emrom, version 0.%d\n", VERSION);
+    clear_buffer(&buffer, 0xFF);
+    memset(coverage, 0, sizeof(coverage));
+    memset(sent, 0, sizeof(sent));
+    memset(&cost, 0, sizeof(struct cost));
+    memset(&naive, 0, sizeof(struct cost));
+
+    if ((result = getc(stream)) != EOF)
+        ungetc(result, stream);
+
+    if (result == ':')
+        result = feed_stream_buffer(&buffer, stream, fold_record, 0);
+    else
+        result = feed_binary(stream);
+
+    if (!result && scrambled)
+    {
+        buffer.origin = 0;
+        buffer.size = get_device_geometry(device);
+        buffer.data = memory;
+        buffer.mask = coverage;
+
+        if (!(result = scramble_image(&buffer)))
+        {
+            cover_buffer_pages(&buffer, PAGE_SIZE);
+            result = write_spans(&buffer);
+        }
+    }
+
+    for (page = 0; !result && !scrambled && page < get_device_geometry(device) / PAGE_SIZE; page++)
+    {
+        if (sent[page] == 2 || !sent[page] && memchr(coverage + page * PAGE_SIZE, 1, PAGE_SIZE))
+            result = send_page(page);
+    }
+
+    if (stream != stdin)
+        fclose(stream);
+
+    if (result)
+        return result;
+
+    if (dry && !scrambled)
+        report_plan();
+
+    report_stall();
+    return DONE;
+}
+
+static int stream_file(const char *file)
+{
+    struct stat status;
+
+    return !strcmp(file, "-") || stat(file, &status) == 0 && S_ISFIFO(status.st_mode);
+}
+
+static int load_board_image(struct board *board, const char *file, int32_t offset)
+{
+    int result;
+    int64_t first = (int64_t)board->base - offset;
+    int64_t last = first + get_device_geometry(device);
+    struct region saved = region;
+    struct buffer buffer =
+    {
+        0, 0, get_device_geometry(device), board->data, board->mask
+    };
+    struct buffer source;
+
+    if (first < 0)
+        first = 0;
+
+    if (last > 0x100000000LL)
+        last = 0x100000000LL;
+
+    if (first >= last)
+        return DONE;
+
+    region.base = first;
+    region.size = last - first;
+    region.offset = first + offset - board->base;
+
+    result = load_image(&source, file);
+    region = saved;
+
+    if (result)
+        return result;
+
+    return merge_buffer(&buffer, &source, 0, conflict);
+}
+
+static int share_board_pages(struct buffer *buffer)
+{
+    size_t i;
+    size_t j;
+
+    clear_buffer(buffer, 0xFF);
+    memset(coverage, 0, sizeof(coverage));
+
+    if (board_count < 2)
+        return 0;
+
+    for (i = 0; i < buffer->size; i += PAGE_SIZE)
+    {
+        size_t count = buffer->size - i < PAGE_SIZE ? buffer->size - i : PAGE_SIZE;
+
+        for (j = 0; j < board_count; j++)
+        {
+            if (!boards[j].mask[i] || memcmp(boards[j].data + i, boards[0].data + i, count))
+                break;
+        }
+
+        if (j < board_count)
+            continue;
+
+        memcpy(memory + i, boards[0].data + i, count);
+        memset(coverage + i, 1, count);
+
+        for (j = 0; j < board_count; j++)
+            memset(boards[j].mask + i, 0, count);
+    }
+
+    return memchr(coverage, 1, buffer->size) != 0;
+}
+
+static int write_board_spans(struct buffer *buffer, int board)
+{
+    int result;
+
+    if ((result = set_device_board(device, board)))
+        return result;
+
+    if (dry)
+        fprintf(stdout, board == DEVICE_BROADCAST_BOARD ? " [broadcast]" : " [board %d]", board);
+
+    return write_spans(buffer);
+}
+
+static int write_boards(struct buffer *buffer)
+{
+    int result;
+    int shared = share_board_pages(buffer);
+    int i;
+
+    if (shared && (result = write_board_spans(buffer, DEVICE_BROADCAST_BOARD)))
+        return result;
+
+    for (i = 0; i < board_count; i++)
+    {
+        struct buffer own =
+        {
+            0, 0, buffer->size, boards[i].data, boards[i].mask
+        };
+
+        if ((result = set_device_board(device, boards[i].id)))
+            return result;
+
+        if (shared && !dry && (result = process_spans(buffer, verify_device_memory)))
+        {
+            if (result != DEVICE_MEMORY_MISMATCH)
+                return result;
+
+            if ((result = write_board_spans(buffer, boards[i].id)))
+                return result;
+        }
+
+        if ((result = write_board_spans(&own, boards[i].id)))
+            return result;
+    }
+
+    return DONE;
+}
+
+static int write_chain(const char *argument)
+{
+    int result;
+    char list[strlen(argument) + 1];
+    char *file;
+    char *state;
+    size_t geometry = get_device_geometry(device);
+    struct buffer buffer =
+    {
+        0, 0, geometry, memory, coverage
+    };
+    int i;
+
+    if ((result = store_shadow()))
+        return result;
+
+    strcpy(list, argument);
+
+    for (i = 0; i < board_count; i++)
+    {
+        memset(boards[i].data, 0xFF, geometry);
+        memset(boards[i].mask, 0, geometry);
+    }
+
+    for (file = strtok_r(list, ",", &state); file; file = strtok_r(0, ",", &state))
+    {
+        char *p = strrchr(file, '@');
+        int32_t offset = 0;
+
+        if (p)
+        {
+            *p++ = 0;
+            offset = strtol(p, &p, 0);
+
+            if (*p)
+                return INVALID_OPTIONS_ARGUMENT;
+        }
+
+        for (i = 0; i < board_count; i++)
+        {
+            if ((result = load_board_image(&boards[i], file, offset)))
+                return result;
+        }
+    }
+
+    for (i = 0; i < board_count; i++)
+    {
+        struct buffer own =
+        {
+            0, 0, geometry, boards[i].data, boards[i].mask
+        };
+
+        if ((result = scramble_image(&own)))
+            return result;
+
+        if (own.data != boards[i].data)
+        {
+            memcpy(boards[i].data, own.data, geometry);
+            memcpy(boards[i].mask, own.mask, geometry);
+            own.data = boards[i].data;
+            own.mask = boards[i].mask;
+        }
+
+        cover_buffer_pages(&own, PAGE_SIZE);
+    }
+
+    result = write_boards(&buffer);
+    set_device_board(device, board);
+    return result;
+}
+
+static int write_images(const char *argument)
+{
+    int result;
+    char list[strlen(argument) + 1];
+    char *file;
+    char *state;
+    struct buffer buffer =
+    {
+        0, 0, MEMORY_SIZE, memory, coverage
+    };
+
+    if (board_count)
+    {
+        if ((result = write_chain(argument)))
+            return result;
+
+        report_stall();
+        return DONE;
+    }
+
+    clear_buffer(&buffer, 0xFF);
+    memset(coverage, 0, sizeof(coverage));
+    strcpy(list, argument);
+
+    for (file = strtok_r(list, ",", &state); file; file = strtok_r(0, ",", &state))
+    {
+        char *p = strrchr(file, '@');
+        int32_t offset = 0;
+        struct buffer source;
+
+        if (p)
+        {
+            *p++ = 0;
+            offset = strtol(p, &p, 0);
+
+            if (*p)
+                return INVALID_OPTIONS_ARGUMENT;
+        }
+
+        if ((result = load_image(&source, file)))
+            return result;
+
+        if ((result = merge_buffer(&buffer, &source, offset, conflict)))
+            return result;
+    }
+
+    if ((result = fold_buffer(&buffer, get_device_geometry(device))))
+        return result;
+
+    if ((result = scramble_image(&buffer)))
+        return result;
+
+    cover_buffer_pages(&buffer, PAGE_SIZE);
+
+    if ((result = write_spans(&buffer)))
+        return result;
+
+    report_stall();
+    return DONE;
+}
+
+static int write_device(const char *argument)
+{
+    int result;
+
+    fprintf(stdout, TTY_NONE "Writing from \"%s\"...", argument);
+
+    if (!dry && (result = begin_device_write(device)))
+        return result;
+
+    result = stream_file(argument) ? write_stream(argument) : write_images(argument);
+    return dry ? result : end_device_write(device, result);
+}
+
+static int conflict_device(const char *argument)
+{
+    static const char *const policies[] =
+    {
+        [REPLACE_CONFLICT] = "replace",
+        [KEEP_CONFLICT] = "keep",
+        [FAIL_CONFLICT] = "fail"
+    };
+
+    int i;
+
+    fprintf(stdout, TTY_NONE "Setting conflict policy \"%s\"...", argument);
+
+    for (i = 0; i < sizeof(policies) / sizeof(policies[0]); i++)
+    {
+        if (!strcmp(argument, policies[i]))
+        {
+            conflict = i;
+            return DONE;
+        }
+    }
+
+    return INVALID_OPTIONS_ARGUMENT;
+}
+
+static int region_device(const char *argument)
+{
+    char *p;
+    unsigned long long base, size, offset = 0;
+
+    fprintf(stdout, TTY_NONE "Setting region \"%s\"...", argument);
+
+    if (!strcmp(argument, "off"))
+    {
+        memset(&region, 0, sizeof(struct region));
+        return DONE;
+    }
+
+    base = strtoull(argument, &p, 0);
+
+    if (*p++ != ':')
+        return INVALID_OPTIONS_ARGUMENT;
+
+    size = strtoull(p, &p, 0);
+
+    if (*p == '@')
+        offset = strtoull(p + 1, &p, 0);
+
+    if (*p || !size || size > MEMORY_SIZE || offset > MEMORY_SIZE - size || base + size > 0x100000000ULL)
+        return INVALID_OPTIONS_ARGUMENT;
+
+    region.base = base;
+    region.size = size;
+    region.offset = offset;
+    return DONE;
+}
+
+static int patch_device(const char *file)
+{
+    int result;
+    struct buffer buffer;
+
+    fprintf(stdout, TTY_NONE "Patching from \"%s\"...", file);
+
+    if ((result = compose_image(&buffer, file)))
+        return result;
+
+    if ((result = write_held_spans(&buffer)))
+        return result;
+
+    report_stall();
+    return DONE;
+}
+
+static int poke_device(const char *argument)
+{
+    int result;
+    char *p;
+    struct buffer buffer =
+    {
+        0, strtoul(argument, &p, 0), 0, memory, coverage
+    };
+
+    fprintf(stdout, TTY_NONE "Poking \"%s\"...", argument);
+
+    if (*p++ != '=')
+        return INVALID_OPTIONS_ARGUMENT;
+
+    while (*p)
+    {
+        if (buffer.origin + buffer.size >= get_device_geometry(device) || !isxdigit(p[0]) || !isxdigit(p[1]) || sscanf(p, "%2hhx", memory + buffer.size) != 1)
+            return INVALID_OPTIONS_ARGUMENT;
+
+        coverage[buffer.size++] = 1;
+        p += 2;
+    }
+
+    if (!buffer.size)
+        return INVALID_OPTIONS_ARGUMENT;
+
+    if ((result = scramble_image(&buffer)))
+        return result;
+
+    if ((result = write_held_spans(&buffer)))
+        return result;
+
+    report_stall();
+    return DONE;
+}
+
+static int erase_device(void)
+{
+    int result;
+
+    fprintf(stdout, TTY_NONE "Erasing...");
+
+    if ((result = erase_device_memory(device, 0xFF)))
+        return result;
+
+    report_stall();
+    return DONE;
+}
+
+static int verify_device(const char *file)
+{
+    int result;
+    struct buffer buffer;
+
+    fprintf(stdout, TTY_NONE "Verifying with \"%s\"...", file);
+
+    if ((result = compose_image(&buffer, file)))
+        return result;
+
+    if ((result = process_spans(&buffer, verify_device_memory)))
+        return result;
+
+    return DONE;
+}
+
+static int blank_check_device(void)
+{
+    int result;
+    uint32_t mismatch;
+
+    fprintf(stdout, TTY_NONE "Checking blank...");
+
+    if ((result = check_device_memory(device, 0, get_device_geometry(device), 0xFF, &mismatch)) == DEVICE_MEMORY_NOT_BLANK)
+        fprintf(stdout, " [0x%04X]", mismatch);
+
+    return result;
+}
+
+static void interrupt(int signal)
+{
+    interrupted = 1;
+}
+
+static double now(void)
+{
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static void print_changes(FILE *stream, double time, const struct buffer *buffer, const uint8_t *last, int all)
+{
+    const uint8_t *data = buffer->data;
+    size_t i = 0;
+
+    while (i < buffer->size)
+    {
+        if (!all && data[i] == last[i])
+        {
+            i++;
+            continue;
+        }
+
+        fprintf(stream, "%.6f %04X:", time, (uint32_t)(buffer->origin + i));
+
+        while (i < buffer->size && (all || data[i] != last[i]))
+            fprintf(stream, " %02X", data[i++]);
+
+        fputc('\n', stream);
+    }
+}
+
+static int watch_memory(const char *argument)
+{
+    int result = DONE;
+    char *p;
+    const char *file = 0;
+    double rate;
+    double duration = 0;
+    double start;
+    double next;
+    double elapsed = 0;
+    size_t samples = 0;
+    uint8_t *last;
+    FILE *stream = stdout;
+    struct buffer buffer =
+    {
+        0, strtoul(argument, &p, 0), 0, memory
+    };
+
+    fprintf(stdout, TTY_NONE "Watching \"%s\"...", argument);
+
+    if (*p++ != ':')
+        return INVALID_OPTIONS_ARGUMENT;
+
+    buffer.size = strtoul(p, &p, 0);
+
+    if (*p++ != '@')
+        return INVALID_OPTIONS_ARGUMENT;
+
+    rate = strtod(p, &p);
+
+    if (*p == '/')
+        duration = strtod(p + 1, &p);
+
+    if (*p == ',')
+    {
+        file = p + 1;
+        p += strlen(p);
+    }
+
+    if (*p || !buffer.size || buffer.origin + buffer.size > get_device_geometry(device) || rate <= 0 || duration < 0)
+        return INVALID_OPTIONS_ARGUMENT;
+
+    if (!(last = malloc(buffer.size)))
+        return INTERNAL_ERROR;
+
+    if (file && !(stream = fopen(file, "w")))
+    {
+        free(last);
+        return INTERNAL_ERROR;
+    }
+
+    if (stream == stdout)
+        fputc('\n', stdout);
+
+    interrupted = 0;
+    signal(SIGINT, interrupt);
+    start = now();
+    next = start;
+
+    while (!interrupted && (!duration || next - start < duration))
+    {
+        double delay = next - now();
+
+        if (delay > 0)
+        {
+            struct timespec time = {delay, (delay - (time_t)delay) * 1e9};
+
+            nanosleep(&time, 0);
+        }
+        else
+        {
+            next = now();
+        }
+
+        next += 1 / rate;
+
+        memcpy(last, memory, buffer.size);
+
+        if ((result = sample_device_memory(device, &buffer)))
+            break;
+
+        elapsed = now() - start;
+        print_changes(stream, elapsed, &buffer, last, !samples);
+        samples++;
+    }
+
+    signal(SIGINT, SIG_DFL);
+
+    if (stream != stdout)
+        fclose(stream);
+
+    free(last);
+
+    if (result)
+        return result;
+
+    fprintf(stdout, " [%zu samples, %.1f Hz]", samples, samples > 1 ? (samples - 1) / elapsed : 0);
+    report_stall();
+    return DONE;
+}
+
+static int hold_device(const char *argument)
+{
+    int result;
+    char *p;
+    long hold = 0;
+
+    fprintf(stdout, TTY_NONE "Setting hold \"%s\"...", argument);
+
+    if (strcmp(argument, "off"))
+    {
+        hold = strtol(argument, &p, 0);
+
+        if (*p || hold < 1)
+            return INVALID_OPTIONS_ARGUMENT;
+    }
+
+    if ((result = set_device_hold(device, hold)))
+        return result;
+
+    report_stall();
+    live = hold != 0;
+    return DONE;
+}
+
+static int control_device(const char *argument)
+{
+    static const struct
+    {
+        const char *name;
+        int control;
+    }
+    controls[] =
+    {
+        {"off", 0},
+        {"hold-rts", DEVICE_HOLD_CONTROL | DEVICE_RTS_CONTROL},
+        {"hold-dtr", DEVICE_HOLD_CONTROL | DEVICE_DTR_CONTROL},
+        {"reset-rts", DEVICE_RESET_CONTROL | DEVICE_RTS_CONTROL},
+        {"reset-dtr", DEVICE_RESET_CONTROL | DEVICE_DTR_CONTROL}
+    };
+
+    int i;
+
+    fprintf(stdout, TTY_NONE "Setting target control \"%s\"...", argument);
+
+    for (i = 0; i < sizeof(controls) / sizeof(controls[0]); i++)
+    {
+        if (!strcmp(argument, controls[i].name))
+        {
+            set_device_control(device, controls[i].control);
+            return DONE;
+        }
+    }
+
+    return INVALID_OPTIONS_ARGUMENT;
+}
+
+static int window_device(const char *argument)
+{
+    int result;
+    char *p;
+    size_t window = strtoul(argument, &p, 0);
+
+    fprintf(stdout, TTY_NONE "Setting window \"%s\"...", argument);
+
+    if (*p)
+        return INVALID_OPTIONS_ARGUMENT;
+
+    if ((result = set_device_window(device, window)))
+        return result;
+
+    return DONE;
+}
+
+static int latency_device(const char *argument)
+{
+    int result;
+    int latency = !strcmp(argument, "on");
+    int features;
+
+    fprintf(stdout, TTY_NONE "Setting latency \"%s\"...", argument);
+
+    if (!latency && strcmp(argument, "off"))
+        return INVALID_OPTIONS_ARGUMENT;
+
+    if ((result = set_device_latency(device, latency, &features)))
+        return result;
+
+    if (latency)
+        fprintf(stdout, " [driver low latency %s, latency timer %s]", features & LOW_LATENCY_FEATURE ? "set" : "unsupported", features & LATENCY_TIMER_FEATURE ? "set" : "unsupported");
+
+    return DONE;
+}
+
+static int probe_device_latency(const char *argument)
+{
+    int result;
+    char *p;
+    struct probe probe;
+    long count = strtol(argument, &p, 0);
+
+    fprintf(stdout, TTY_NONE "Probing round trip %s times...", argument);
+
+    if (*p || count < 1)
+        return INVALID_OPTIONS_ARGUMENT;
+
+    if ((result = probe_device(device, count, &probe)))
+        return result;
+
+    fprintf(stdout, " [min %.2f ms, average %.2f ms, max %.2f ms]", 1e3 * probe.min, 1e3 * probe.average, 1e3 * probe.max);
+    return DONE;
+}
+
+static int shadow_device(const char *argument)
+{
+    int result;
+    int known = 0;
+    int i;
+    char *p;
+
+    fprintf(stdout, TTY_NONE "Setting shadow \"%s\"...", argument);
+
+    if ((result = store_shadow()))
+        return result;
+
+    if (!strcmp(argument, "off"))
+        return DONE;
+
+    if (strcmp(argument, "on") && strcmp(argument, "check"))
+        return INVALID_OPTIONS_ARGUMENT;
+
+    if (!*config || !*port || snprintf(shadow_file, sizeof(shadow_file), "%s.d", config) >= sizeof(shadow_file))
+        return INVALID_OPTIONS_ARGUMENT;
+
+    if (mkdir(shadow_file, 0777) < 0 && errno != EEXIST)
+        return INTERNAL_ERROR;
+
+    p = shadow_file + strlen(shadow_file);
+
+    if (snprintf(p, sizeof(shadow_file) - (p - shadow_file), "/%s.shadow", port) >= sizeof(shadow_file) - (p - shadow_file))
+        return INVALID_OPTIONS_ARGUMENT;
+
+    for (p++; *p; p++)
+    {
+        if (*p == '/')
+            *p = '_';
+    }
+
+    if ((result = load_shadow(&shadow, shadow_file)))
+        return result;
+
+    if (!strcmp(argument, "check") && (result = verify_device_shadow(device, &shadow)))
+        return result;
+
+    set_device_shadow(device, &shadow);
+
+    for (i = 0; i < SHADOW_PAGE_COUNT; i++)
+        known += shadow.known[i];
+
+    fprintf(stdout, " [%d of %d pages known]", known, SHADOW_PAGE_COUNT);
+    return DONE;
+}
+
+static int rom_device(const char *argument)
+{
+    static const struct
+    {
+        const char *name;
+        size_t size;
+    }
+    profiles[] =
+    {
+        {"2716", 0x0800},
+        {"2732", 0x1000},
+        {"2764", 0x2000},
+        {"27128", 0x4000},
+        {"27256", 0x8000},
+        {"27512", 0x10000}
+    };
+
+    int result;
+    struct settings settings;
+    size_t size;
+    char *p;
+    int i;
+
+    fprintf(stdout, TTY_NONE "Setting ROM \"%s\"...", argument);
+
+    get_device_settings(device, &settings);
+    size = strtoul(argument, &p, 0);
+
+    if (!strcmp(argument, "device"))
+    {
+        size = settings.identity.memory < MEMORY_SIZE ? settings.identity.memory : MEMORY_SIZE;
+        p = "";
+    }
+
+    for (i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++)
+    {
+        if (!strcmp(argument, profiles[i].name))
+            size = profiles[i].size;
+    }
+
+    if (*p)
+        return INVALID_OPTIONS_ARGUMENT;
+
+    if ((result = set_device_geometry(device, size)))
+        return result;
+
+    fprintf(stdout, " [%zu bytes]", size);
+    return DONE;
+}
+
+static int scramble_line(char c)
+{
+    return isdigit(c) ? c - '0' : tolower(c) - 'a' + 10;
+}
+
+static int scramble_device(const char *argument)
+{
+    int address[SCRAMBLE_ADDRESS_LINES];
+    int data[SCRAMBLE_DATA_LINES];
+    const char *p = argument;
+    int result;
+    int count;
+    int i;
+
+    fprintf(stdout, TTY_NONE "Setting scramble \"%s\"...", argument);
+
+    if (!strcmp(argument, "off"))
+    {
+        scrambled = 0;
+        return DONE;
+    }
+
+    for (i = 0; i < SCRAMBLE_ADDRESS_LINES; i++)
+        address[i] = i;
+
+    for (i = 0; i < SCRAMBLE_DATA_LINES; i++)
+        data[i] = i;
+
+    for (count = 0; isxdigit(p[count]); count++)
+        continue;
+
+    if (!count || count > SCRAMBLE_ADDRESS_LINES)
+        return INVALID_OPTIONS_ARGUMENT;
+
+    for (i = 0; i < count; i++)
+        address[count - 1 - i] = scramble_line(p[i]);
+
+    p += count;
+
+    if (*p == ':')
+    {
+        for (count = 0; isxdigit(p[1 + count]); count++)
+            continue;
+
+        if (count != SCRAMBLE_DATA_LINES)
+            return INVALID_OPTIONS_ARGUMENT;
+
+        for (i = 0; i < count; i++)
+            data[count - 1 - i] = scramble_line(p[1 + i]);
+
+        p += 1 + count;
+    }
+
+    if (*p)
+        return INVALID_OPTIONS_ARGUMENT;
+
+    if ((result = init_scramble(&scramble, address, data)))
+        return result;
+
+    scrambled = 1;
+    return DONE;
+}
+
+static int identify_board(int id, int features)
+{
+    int result;
+    size_t geometry = get_device_geometry(device);
+    struct identity identity;
+
+    if ((result = set_device_board(device, id)))
+        return result;
+
+    if ((result = identify_device(device, &identity)))
+        return result;
+
+    if ((result = set_device_geometry(device, geometry)))
+        return result;
+
+    if (identity.protocol < DEVICE_BOARD_PROTOCOL)
+        return NO_DEVICE_REPLY;
+
+    if ((identity.features & features) != features)
+        return UNCHAINED_DEVICE_FIRMWARE;
+
+    return DONE;
+}
+
+static int chain_device(const char *argument)
+{
+    char list[strlen(argument) + 1];
+    char *item;
+    char *state;
+    int result;
+    int count = 0;
+    int i;
+
+    fprintf(stdout, TTY_NONE "Setting chain \"%s\"...", argument);
+
+    board_count = 0;
+
+    if (!strcmp(argument, "off"))
+        return DONE;
+
+    strcpy(list, argument);
+
+    for (item = strtok_r(list, ",", &state); item; item = strtok_r(0, ",", &state))
+    {
+        char *p;
+        long id = strtol(item, &p, 0);
+        unsigned long long base;
+
+        if (p == item || *p != '@' || id < 0 || id >= DEVICE_BOARD_LIMIT || count == BOARD_LIMIT)
+            return INVALID_OPTIONS_ARGUMENT;
+
+        base = strtoull(p + 1, &p, 0);
+
+        if (*p || base % PAGE_SIZE || base + get_device_geometry(device) > 0x100000000ULL)
+            return INVALID_OPTIONS_ARGUMENT;
+
+        for (i = 0; i < count; i++)
+        {
+            if (boards[i].id == id || boards[i].base < base + get_device_geometry(device) && base < boards[i].base + get_device_geometry(device))
+                return INVALID_OPTIONS_ARGUMENT;
+        }
+
+        boards[count].id = id;
+        boards[count].base = base;
+        count++;
+    }
+
+    if (!count)
+        return INVALID_OPTIONS_ARGUMENT;
+
+    for (i = 0; i < count; i++)
+    {
+        if ((result = identify_board(boards[i].id, DEVICE_CHAIN_FEATURE)))
+            return result;
+    }
+
+    board_count = count;
+    return set_device_board(device, board);
+}
+
+static int board_device(const char *argument)
+{
+    int result;
+    char *p;
+    long id;
+
+    fprintf(stdout, TTY_NONE "Selecting board \"%s\"...", argument);
+
+    if (!strcmp(argument, "off"))
+    {
+        board = DEVICE_NO_BOARD;
+        return set_device_board(device, board);
+    }
+
+    id = strtol(argument, &p, 0);
+
+    if (p == argument || *p || id < 0 || id >= DEVICE_BOARD_LIMIT)
+        return INVALID_OPTIONS_ARGUMENT;
+
+    if ((result = store_shadow()))
+        return result;
+
+    if ((result = identify_board(id, 0)))
+        return result;
+
+    board = id;
+    return DONE;
+}
+
+static int dry_run_device(const char *argument)
+{
+    fprintf(stdout, TTY_NONE "Setting dry run \"%s\"...", argument);
+
+    if (strcmp(argument, "on") && strcmp(argument, "off"))
+        return INVALID_OPTIONS_ARGUMENT;
+
+    dry = !strcmp(argument, "on");
+    return DONE;
+}
+
+static int disconnect_device(void)
+{
+    int result;
+
+    fprintf(stdout, TTY_NONE "Disconnecting...");
+
+    if ((result = store_shadow()))
+        return result;
+
+    if ((result = close_device(device)))
+        return result;
+
+    return DONE;
+}
+
+static int wait_device(const char *argument)
+{
+    int result;
+    char *p;
+    long ms = strtol(argument, &p, 0);
+
+    fprintf(stdout, TTY_NONE "Waiting %s ms...", argument);
+
+    if (*p || ms < 0)
+        return INVALID_OPTIONS_ARGUMENT;
+
+    if ((result = wait_serial_port(ms)))
+        return result;
+
+    return DONE;
+}
+
+static int script_device(const char *file);
+
+static const char synopsis[] = TTY_BOLD "emrom" TTY_NONE " [" TTY_UNLN "OPTIONS" TTY_NONE "] ";
+
+static const struct option options[] =
+{
+    {JOINT_OPTION, "c", "connect", "Open serial port and connect to device", connect_device},
+    {JOINT_OPTION, "r", "read", "Read data from device memory to file", read_device},
+    {JOINT_OPTION, "b", "binary", "Read data from device memory to raw binary file", read_device_binary},
+    {JOINT_OPTION, "t", "trim", "Strip bytes of given value from both ends of following reads", trim_device},
+    {JOINT_OPTION, "w", "write", "Write data from files or a stream to device memory", write_device},
+    {JOINT_OPTION, "o", "conflict", "Policy for bytes covered by several files of one write", conflict_device},
+    {JOINT_OPTION, "u", "region", "Take only one address region from following files", region_device},
+    {JOINT_OPTION, "p", "patch", "Write only bytes present in file to device memory", patch_device},
+    {JOINT_OPTION, "k", "poke", "Write hex bytes to device memory at address", poke_device},
+    {PLAIN_OPTION, "e", "erase", "Erase device memory", erase_device},
+    {JOINT_OPTION, "v", "verify", "Compare device memory with data from file", verify_device},
+    {PLAIN_OPTION, "y", "blank-check", "Check that device memory is erased", blank_check_device},
+    {JOINT_OPTION, "W", "watch-mem", "Sample device memory range and print changes", watch_memory},
+    {JOINT_OPTION, "s", "script", "Run commands from file", script_device},
+    {JOINT_OPTION, "z", "wait", "Wait given number of milliseconds", wait_device},
+    {JOINT_OPTION, "g", "hold", "Limit target bus takeover per write frame", hold_device},
+    {JOINT_OPTION, "x", "control", "Drive target with modem line around writes", control_device},
+    {JOINT_OPTION, "j", "shadow", "Keep a copy of device memory and skip pages it holds", shadow_device},
+    {JOINT_OPTION, "R", "rom", "ROM size that device memory commands cover", rom_device},
+    {JOINT_OPTION, "S", "scramble", "Permute address and data lines of device memory", scramble_device},
+    {JOINT_OPTION, "C", "chain", "Map emulators chained on serial port to a wide image", chain_device},
+    {JOINT_OPTION, "B", "board", "Send following commands to one chained emulator", board_device},
+    {JOINT_OPTION, "f", "dry-run", "Print plan of following writes instead of sending them", dry_run_device},
+    {JOINT_OPTION, "n", "window", "Number of write frames sent ahead of acknowledgements", window_device},
+    {JOINT_OPTION, "l", "latency", "Low latency mode of serial port driver", latency_device},
+    {JOINT_OPTION, "q", "probe", "Measure page read round trip time", probe_device_latency},
+    {PLAIN_OPTION, "i", "identify", "Query device firmware capabilities again", identify_device_again},
+    {JOINT_OPTION, "m", "timeout", "Device reply timeout in milliseconds", timeout_device},
+    {PLAIN_OPTION, "a", "calibrate", "Measure link and apply the fastest reliable settings", calibrate_device_link},
+    {PLAIN_OPTION, "d", "disconnect", "Disconnect device and close serial port", disconnect_device},
+    {USAGE_OPTION, "h", "help", "Print this help", usage_options},
+    {OTHER_OPTION}
+};
+
+static const struct error errors[] =
+{
+    {UNCHAINED_DEVICE_FIRMWARE, "Device firmware is not built for a chain of boards"},
+    {DEVICE_MEMORY_NOT_BLANK, "Device memory is not blank"},
+    {MISSING_SETTINGS, "No stored settings for serial port"},
+    {OVERLAPPING_FILE_CONTENT, "Files of one write overlap or file content differs between ROM mirrors"},
+    {DEVICE_MEMORY_MISMATCH, "Device memory differs from file"},
+    {INVALID_FILE_CHECKSUM, "Invalid checksum of file"},
+    {INVALID_FILE_CONTENT, "Invalid device memory location or invalid record in file"},
+    {INVALID_DEVICE_REPLY, "Invalid reply from device bootloader"},
+    {NO_DEVICE_REPLY, "No reply from device bootloader"},
+    {SERIAL_PORT_ALREADY_OPEN, "Serial port already open"},
+    {INTERNAL_ERROR, "Internal error"},
+    {INVALID_OPTIONS_ARGUMENT, "Invalid actual parameter"},
+    {INVALID_OPTION, "Invalid option"},
+    {DONE, "No errors, all done"},
+};
+
+static int script_device(const char *file)
+{
+    int result;
+    FILE *stream = strcmp(file, "-") ? fopen(file, "rt") : stdin;
+
+    fprintf(stdout, TTY_NONE "Running script \"%s\"...\n", file);
+
+    if (!stream)
+        return INTERNAL_ERROR;
+
+    result = invoke_script(synopsis, options, errors, stream);
+
+    if (stream != stdin && fclose(stream) && !result)
+        return INTERNAL_ERROR;
+
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    static char stdout_buffer[256];
+    int result;
+
+    setvbuf(stdout, stdout_buffer, _IOLBF, sizeof(stdout_buffer));
+    fprintf(stdout, TTY_NONE "Emrom, version 0.%d\n", VERSION);
+
+    if (getenv("HOME"))
+        snprintf(config, sizeof(config), "%s/.emrom", getenv("HOME"));
+
+    if (!(device = create_device()))
+        return INTERNAL_ERROR;
+
+    watch_device(device, progress, 0);
+
+    result = invoke_options(synopsis, options, errors, argc, argv);
 
-    return invoke_options(TTY_BOLD "emrom" TTY_NONE " [" TTY_UNLN "OPTIONS" TTY_NONE "] ", options, errors, argc, argv);
+    store_shadow();
+    destroy_device(device);
+    free_images();
+    return result;
 }
 
@@ -0,0 +1,114 @@
+/*
+ * Emrom - ROM emulator software
+ * Copyright (c) 2016 rksdna
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+#include "errors.h"
+#include "scramble.h"
+
+static int invert_lines(const int *lines, int *inverse, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+        inverse[i] = -1;
+
+    for (i = 0; i < count; i++)
+    {
+        if (lines[i] < 0 || lines[i] >= count || inverse[lines[i]] >= 0)
+            return INVALID_OPTIONS_ARGUMENT;
+
+        inverse[lines[i]] = i;
+    }
+
+    return DONE;
+}
+
+static uint16_t permute(const int *lines, int value, int first, int count)
+{
+    uint16_t result = 0;
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (value & 1 << i)
+            result |= 1 << lines[first + i];
+    }
+
+    return result;
+}
+
+int init_scramble(struct scramble *scramble, const int address[SCRAMBLE_ADDRESS_LINES], const int data[SCRAMBLE_DATA_LINES])
+{
+    int inverse_address[SCRAMBLE_ADDRESS_LINES];
+    int inverse_data[SCRAMBLE_DATA_LINES];
+    int result;
+    int i;
+
+    if ((result = invert_lines(address, inverse_address, SCRAMBLE_ADDRESS_LINES)))
+        return result;
+
+    if ((result = invert_lines(data, inverse_data, SCRAMBLE_DATA_LINES)))
+        return result;
+
+    for (i = 0; i < 256; i++)
+    {
+        scramble->address[0][i] = permute(address, i, 0, 8);
+        scramble->address[1][i] = permute(address, i, 8, 8);
+        scramble->inverse_address[0][i] = permute(inverse_address, i, 0, 8);
+        scramble->inverse_address[1][i] = permute(inverse_address, i, 8, 8);
+        scramble->data[i] = permute(data, i, 0, 8);
+        scramble->inverse_data[i] = permute(inverse_data, i, 0, 8);
+    }
+
+    return DONE;
+}
+
+int scramble_buffer(const struct scramble *scramble, const struct buffer *source, struct buffer *target, int inverse)
+{
+    const uint16_t (*address)[256] = inverse ? scramble->inverse_address : scramble->address;
+    const uint8_t *data = inverse ? scramble->inverse_data : scramble->data;
+    const uint8_t *from = source->data;
+    uint8_t *to = target->data;
+    size_t i;
+
+    for (i = 0; i < source->size; i++)
+    {
+        uint32_t location = source->origin + i;
+        int64_t index;
+
+        if (source->mask && !source->mask[i])
+            continue;
+
+        index = (int64_t)((location & ~0xFFFF) | address[0][location & 0xFF] | address[1][(location >> 8) & 0xFF]) - target->origin;
+
+        if (index < 0 || index >= target->size)
+            return INVALID_FILE_CONTENT;
+
+        to[index] = data[from[i]];
+
+        if (target->mask)
+            target->mask[index] = 1;
+    }
+
+    return DONE;
+}
@@ -0,0 +1,44 @@
+/*
+ * Emrom - ROM emulator software
+ * Copyright (c) 2016 rksdna
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SCRAMBLE_H
+#define SCRAMBLE_H
+
+#include <stdint.h>
+#include "buffer.h"
+
+#define SCRAMBLE_ADDRESS_LINES 16
+#define SCRAMBLE_DATA_LINES 8
+
+struct scramble
+{
+    uint16_t address[2][256];
+    uint16_t inverse_address[2][256];
+    uint8_t data[256];
+    uint8_t inverse_data[256];
+};
+
+int init_scramble(struct scramble *scramble, const int address[SCRAMBLE_ADDRESS_LINES], const int data[SCRAMBLE_DATA_LINES]);
+int scramble_buffer(const struct scramble *scramble, const struct buffer *source, struct buffer *target, int inverse);
+
+#endif
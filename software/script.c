@@ -0,0 +1,156 @@
+/*
+ * Emrom - ROM emulator software
+ * Copyright (c) 2016 rksdna
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <time.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "errors.h"
+#include "script.h"
+
+#define LINE_SIZE 1024
+
+struct step
+{
+    int line;
+    double time;
+    char *text;
+};
+
+static double now(void)
+{
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static char *strip(char *p)
+{
+    char *end = p;
+
+    while ((end = strchr(end, '#')) && end > p && !isspace(end[-1]))
+        end++;
+
+    if (end)
+        *end = 0;
+
+    while (isspace(*p))
+        p++;
+
+    end = p + strlen(p);
+
+    while (end > p && isspace(end[-1]))
+        *--end = 0;
+
+    return p;
+}
+
+static int invoke(const char *synopsis, const struct option options[], const struct error errors[], char *text)
+{
+    char name[LINE_SIZE + 2] = "--";
+    char *argv[4] = {"script", name, 0, 0};
+    char *p = text;
+
+    while (*p && !isspace(*p))
+        p++;
+
+    if (*p)
+    {
+        *p++ = 0;
+        argv[2] = strip(p);
+    }
+
+    strcat(name, text);
+    return invoke_options(synopsis, options, errors, argv[2] ? 3 : 2, argv);
+}
+
+static void report(const struct step *steps, int count)
+{
+    double total = 0;
+    int i;
+
+    fprintf(stdout, TTY_NONE "Steps:\n");
+
+    for (i = 0; i < count; i++)
+    {
+        fprintf(stdout, TTY_NONE "\t%d\t%9.3f s\t%s\n", steps[i].line, steps[i].time, steps[i].text);
+        total += steps[i].time;
+    }
+
+    fprintf(stdout, TTY_NONE "\t\t%9.3f s\ttotal\n", total);
+}
+
+int invoke_script(const char *synopsis, const struct option options[], const struct error errors[], FILE *stream)
+{
+    struct step *steps = 0;
+    char data[LINE_SIZE];
+    int result = DONE;
+    int count = 0;
+    int line = 0;
+
+    while (!result && fgets(data, sizeof(data), stream))
+    {
+        char *text = strip(data);
+        struct step *step;
+        double time;
+
+        line++;
+
+        if (!*text)
+            continue;
+
+        if (!(step = realloc(steps, (count + 1) * sizeof(struct step))))
+        {
+            result = INTERNAL_ERROR;
+            break;
+        }
+
+        steps = step;
+        step = &steps[count++];
+        step->line = line;
+
+        if (!(step->text = strdup(text)))
+        {
+            result = INTERNAL_ERROR;
+            count--;
+            break;
+        }
+
+        time = now();
+        result = invoke(synopsis, options, errors, text);
+        step->time = now() - time;
+    }
+
+    if (!result && ferror(stream))
+        result = INTERNAL_ERROR;
+
+    report(steps, count);
+
+    while (count--)
+        free(steps[count].text);
+
+    free(steps);
+    return result;
+}
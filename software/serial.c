@@ -22,74 +22,179 @@
  */
 
 #include <time.h>
+#include <poll.h>
+#include <stdio.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <libgen.h>
 #include <termios.h>
 #include <sys/ioctl.h>
+#include <linux/serial.h>
 #include "errors.h"
 #include "serial.h"
 
-static int fd = -1;
-static struct termios shadow_options;
-static struct termios active_options;
-static int shadow_status;
-static int active_status;
+#define SERIAL_TIMEOUT 500
 
-int open_serial_port(const char *file)
+void init_serial_port(struct serial_port *port)
 {
-    if (fd >= 0)
+    port->fd = -1;
+    port->timeout = SERIAL_TIMEOUT;
+}
+
+int open_serial_port(struct serial_port *port, const char *file)
+{
+    if (port->fd >= 0)
         return SERIAL_PORT_ALREADY_OPEN;
 
-    if ((fd = open(file, O_RDWR | O_NOCTTY)) < 0)
+    if ((port->fd = open(file, O_RDWR | O_NOCTTY)) < 0)
         return INTERNAL_ERROR;
 
-    if (tcgetattr(fd, &shadow_options) < 0)
+    port->latency = 0;
+    port->features = 0;
+    port->shadow_latency = -1;
+    port->shadow_flags = -1;
+    strncpy(port->file, file, sizeof(port->file) - 1);
+
+    if (tcgetattr(port->fd, &port->shadow_options) < 0)
         return INTERNAL_ERROR;
 
-    active_options = shadow_options;
+    port->active_options = port->shadow_options;
+
+    port->modem = ioctl(port->fd, TIOCMGET, &port->shadow_status) == 0;
 
-    if (ioctl(fd, TIOCMGET, &shadow_options) < 0)
+    if (!port->modem && errno != ENOTTY && errno != EINVAL)
         return INTERNAL_ERROR;
 
-    active_status = shadow_status;
+    port->active_status = port->shadow_status;
+
+    port->active_options.c_cflag = B57600 | CS8 | CLOCAL | CREAD;
+    port->active_options.c_iflag = IGNBRK | IGNPAR;
+    port->active_options.c_oflag = 0;
+    port->active_options.c_lflag = 0;
+    port->active_options.c_cc[VMIN] = 0;
+    port->active_options.c_cc[VTIME] = (port->timeout + 99) / 100;
 
-    active_options.c_cflag = B57600 | CS8 | CLOCAL | CREAD;
-    active_options.c_iflag = IGNBRK | IGNPAR;
-    active_options.c_oflag = 0;
-    active_options.c_lflag = 0;
-    active_options.c_cc[VMIN] = 0;
-    active_options.c_cc[VTIME] = 5;
+    if (tcflush(port->fd, TCIFLUSH) < 0)
+        return INTERNAL_ERROR;
 
-    if (tcflush(fd, TCIFLUSH) < 0)
+    if (tcsetattr(port->fd, TCSANOW, &port->active_options) < 0)
         return INTERNAL_ERROR;
 
-    if (tcsetattr(fd, TCSANOW, &active_options) < 0)
+    return DONE;
+}
+
+static int latency_timer_path(const struct serial_port *port, char *path, size_t size)
+{
+    char target[PATH_MAX];
+
+    if (!realpath(port->file, target))
+        return 0;
+
+    return snprintf(path, size, "/sys/class/tty/%s/device/latency_timer", basename(target)) < size;
+}
+
+static int swap_latency_timer(struct serial_port *port, int value)
+{
+    char path[PATH_MAX];
+    FILE *stream;
+    int shadow = -1;
+
+    if (!latency_timer_path(port, path, sizeof(path)) || !(stream = fopen(path, "r+")))
+        return -1;
+
+    if (fscanf(stream, "%d", &shadow) != 1 || fseek(stream, 0, SEEK_SET) || fprintf(stream, "%d\n", value) < 0)
+        shadow = -1;
+
+    if (fclose(stream))
+        shadow = -1;
+
+    return shadow;
+}
+
+static int swap_serial_flags(struct serial_port *port, int flags, int mask)
+{
+    struct serial_struct serial;
+    int shadow;
+
+    if (ioctl(port->fd, TIOCGSERIAL, &serial) < 0)
+        return -1;
+
+    shadow = serial.flags;
+    serial.flags = (shadow & ~mask) | (flags & mask);
+
+    if (ioctl(port->fd, TIOCSSERIAL, &serial) < 0)
+        return -1;
+
+    return shadow;
+}
+
+int tune_serial_port(struct serial_port *port, int latency, int timeout)
+{
+    if (timeout < 100 || timeout > 25500)
+        return INVALID_OPTIONS_ARGUMENT;
+
+    if (latency && !port->latency)
+    {
+        port->features = 0;
+
+        if ((port->shadow_flags = swap_serial_flags(port, ASYNC_LOW_LATENCY, ASYNC_LOW_LATENCY)) >= 0)
+            port->features |= LOW_LATENCY_FEATURE;
+
+        if ((port->shadow_latency = swap_latency_timer(port, 1)) >= 0)
+            port->features |= LATENCY_TIMER_FEATURE;
+    }
+
+    if (!latency && port->latency)
+    {
+        if (port->shadow_flags >= 0 && swap_serial_flags(port, port->shadow_flags, ASYNC_LOW_LATENCY) < 0)
+            return INTERNAL_ERROR;
+
+        if (port->shadow_latency >= 0 && swap_latency_timer(port, port->shadow_latency) < 0)
+            return INTERNAL_ERROR;
+
+        port->features = 0;
+        port->shadow_flags = -1;
+        port->shadow_latency = -1;
+    }
+
+    port->timeout = timeout;
+    port->active_options.c_cc[VMIN] = 0;
+    port->active_options.c_cc[VTIME] = (timeout + 99) / 100;
+
+    if (tcsetattr(port->fd, TCSANOW, &port->active_options) < 0)
         return INTERNAL_ERROR;
 
+    port->latency = latency;
     return DONE;
 }
 
-int close_serial_port(void)
+int close_serial_port(struct serial_port *port)
 {
-    if (ioctl(fd, TIOCMSET, &shadow_status) < 0)
+    if (port->latency && tune_serial_port(port, 0, port->timeout))
+        return INTERNAL_ERROR;
+
+    if (port->modem && ioctl(port->fd, TIOCMSET, &port->shadow_status) < 0)
         return INTERNAL_ERROR;
 
-    if (tcsetattr(fd, TCSANOW, &shadow_options) < 0)
+    if (tcsetattr(port->fd, TCSANOW, &port->shadow_options) < 0)
         return INTERNAL_ERROR;
 
-    if (close(fd) < 0)
+    if (close(port->fd) < 0)
         return INTERNAL_ERROR;
 
-    fd = -1;
+    port->fd = -1;
     return DONE;
 }
 
-int write_serial_port(const void *data, size_t size)
+int write_serial_port(struct serial_port *port, const void *data, size_t size)
 {
     while (size)
     {
-        ssize_t count = write(fd, data, size);
+        ssize_t count = write(port->fd, data, size);
 
         if (count < 0)
         {
@@ -106,13 +211,78 @@ int write_serial_port(const void *data, size_t size)
     return DONE;
 }
 
-int read_serial_port(void *data, size_t size)
+int write_vector_serial_port(struct serial_port *port, struct iovec *vector, int count)
+{
+    while (count)
+    {
+        ssize_t size = writev(port->fd, vector, count);
+
+        if (size < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            return INTERNAL_ERROR;
+        }
+
+        while (count && size >= vector->iov_len)
+        {
+            size -= vector->iov_len;
+            vector++;
+            count--;
+        }
+
+        if (count)
+        {
+            vector->iov_base += size;
+            vector->iov_len -= size;
+        }
+    }
+
+    return DONE;
+}
+
+int poll_serial_port(struct serial_port *port, int timeout)
+{
+    struct pollfd poller = {port->fd, POLLIN, 0};
+    int result;
+
+    while ((result = poll(&poller, 1, timeout)) < 0)
+    {
+        if (errno != EINTR)
+            return INTERNAL_ERROR;
+    }
+
+    return result ? DONE : NO_DEVICE_REPLY;
+}
+
+static int expect_serial_port(struct serial_port *port, size_t size)
+{
+    cc_t count = size < UCHAR_MAX ? size : UCHAR_MAX;
+
+    if (port->active_options.c_cc[VMIN] != count)
+    {
+        port->active_options.c_cc[VMIN] = count;
+        port->active_options.c_cc[VTIME] = 1;
+
+        if (tcsetattr(port->fd, TCSANOW, &port->active_options) < 0)
+            return INTERNAL_ERROR;
+    }
+
+    return poll_serial_port(port, port->timeout);
+}
+
+int read_serial_port(struct serial_port *port, void *data, size_t size)
 {
     while (size)
     {
-        ssize_t count = read(fd, data, size);
+        ssize_t count;
+        int result;
 
-        if (count < 0)
+        if (port->latency && (result = expect_serial_port(port, size)))
+            return result;
+
+        if ((count = read(port->fd, data, size)) < 0)
         {
             if (errno == EINTR)
                 continue;
@@ -130,25 +300,39 @@ int read_serial_port(void *data, size_t size)
     return DONE;
 }
 
-int flush_serial_port(void)
+int flush_serial_port(struct serial_port *port)
+{
+    if (tcflush(port->fd, TCIOFLUSH) < 0)
+        return INTERNAL_ERROR;
+
+    return DONE;
+}
+
+int drain_serial_port(struct serial_port *port)
 {
-    if (tcflush(fd, TCIOFLUSH) < 0)
+    if (tcdrain(port->fd) < 0)
         return INTERNAL_ERROR;
 
     return DONE;
 }
 
-int control_serial_port(int rts, int dtr)
+int control_serial_port(struct serial_port *port, int rts, int dtr)
 {
-    active_status &= ~(TIOCM_RTS | TIOCM_DTR);
+    if (!port->modem)
+    {
+        errno = ENOTTY;
+        return INTERNAL_ERROR;
+    }
+
+    port->active_status &= ~(TIOCM_RTS | TIOCM_DTR);
 
     if (rts)
-        active_status |= TIOCM_RTS;
+        port->active_status |= TIOCM_RTS;
 
     if (dtr)
-        active_status |= TIOCM_DTR;
+        port->active_status |= TIOCM_DTR;
 
-    if (ioctl(fd, TIOCMSET, &active_status) < 0)
+    if (ioctl(port->fd, TIOCMSET, &port->active_status) < 0)
         return INTERNAL_ERROR;
 
     return DONE;
@@ -25,15 +25,43 @@
 #define SERIAL_H
 
 #include <stddef.h>
+#include <termios.h>
+#include <sys/uio.h>
+#include <limits.h>
 
-int open_serial_port(const char *file);
-int close_serial_port(void);
+#define LOW_LATENCY_FEATURE 0x01
+#define LATENCY_TIMER_FEATURE 0x02
 
-int write_serial_port(const void *data, size_t size);
-int read_serial_port(void *data, size_t size);
-int flush_serial_port(void);
+struct serial_port
+{
+    int fd;
+    struct termios shadow_options;
+    struct termios active_options;
+    int shadow_status;
+    int active_status;
+    int modem;
+    int timeout;
+    int latency;
+    int features;
+    int shadow_flags;
+    int shadow_latency;
+    char file[PATH_MAX];
+};
 
-int control_serial_port(int rts, int dtr);
+void init_serial_port(struct serial_port *port);
+
+int open_serial_port(struct serial_port *port, const char *file);
+int close_serial_port(struct serial_port *port);
+int tune_serial_port(struct serial_port *port, int latency, int timeout);
+
+int write_serial_port(struct serial_port *port, const void *data, size_t size);
+int write_vector_serial_port(struct serial_port *port, struct iovec *vector, int count);
+int read_serial_port(struct serial_port *port, void *data, size_t size);
+int poll_serial_port(struct serial_port *port, int timeout);
+int flush_serial_port(struct serial_port *port);
+int drain_serial_port(struct serial_port *port);
+
+int control_serial_port(struct serial_port *port, int rts, int dtr);
 int wait_serial_port(int ms);
 
 #endif
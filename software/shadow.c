@@ -0,0 +1,128 @@
+/*
+ * Emrom - ROM emulator software
+ * Copyright (c) 2016 rksdna
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include "errors.h"
+#include "shadow.h"
+
+void clear_shadow(struct shadow *shadow)
+{
+    memset(shadow->known, 0, sizeof(shadow->known));
+}
+
+int load_shadow(struct shadow *shadow, const char *file)
+{
+    FILE *stream = fopen(file, "rb");
+    size_t count;
+
+    clear_shadow(shadow);
+
+    if (!stream)
+        return errno == ENOENT ? DONE : INTERNAL_ERROR;
+
+    count = fread(shadow, 1, sizeof(struct shadow), stream);
+
+    if (fclose(stream))
+        return INTERNAL_ERROR;
+
+    if (count != sizeof(struct shadow))
+        clear_shadow(shadow);
+
+    return DONE;
+}
+
+int save_shadow(const struct shadow *shadow, const char *file)
+{
+    char temporary[PATH_MAX];
+    FILE *stream;
+
+    if (snprintf(temporary, sizeof(temporary), "%s.tmp", file) >= sizeof(temporary) || !(stream = fopen(temporary, "wb")))
+        return INTERNAL_ERROR;
+
+    if ((fwrite(shadow, 1, sizeof(struct shadow), stream) != sizeof(struct shadow)) | fclose(stream))
+        return INTERNAL_ERROR;
+
+    if (rename(temporary, file) < 0)
+        return INTERNAL_ERROR;
+
+    return DONE;
+}
+
+void update_shadow(struct shadow *shadow, uint32_t address, const uint8_t *data, size_t size)
+{
+    while (size && address < DEVICE_MEMORY_SIZE)
+    {
+        size_t count = DEVICE_PAGE_SIZE - address % DEVICE_PAGE_SIZE;
+
+        if (count > size)
+            count = size;
+
+        memcpy(shadow->data + address, data, count);
+
+        if (count == DEVICE_PAGE_SIZE)
+            shadow->known[address / DEVICE_PAGE_SIZE] = 1;
+
+        address += count;
+        data += count;
+        size -= count;
+    }
+}
+
+void forget_shadow(struct shadow *shadow, uint32_t address, size_t size)
+{
+    while (size && address < DEVICE_MEMORY_SIZE)
+    {
+        size_t count = DEVICE_PAGE_SIZE - address % DEVICE_PAGE_SIZE;
+
+        if (count > size)
+            count = size;
+
+        shadow->known[address / DEVICE_PAGE_SIZE] = 0;
+
+        address += count;
+        size -= count;
+    }
+}
+
+int match_shadow(const struct shadow *shadow, uint32_t address, const uint8_t *data, size_t size)
+{
+    while (size)
+    {
+        size_t count = DEVICE_PAGE_SIZE - address % DEVICE_PAGE_SIZE;
+
+        if (count > size)
+            count = size;
+
+        if (address >= DEVICE_MEMORY_SIZE || !shadow->known[address / DEVICE_PAGE_SIZE] || memcmp(shadow->data + address, data, count))
+            return 0;
+
+        address += count;
+        data += count;
+        size -= count;
+    }
+
+    return 1;
+}
@@ -0,0 +1,46 @@
+/*
+ * Emrom - ROM emulator software
+ * Copyright (c) 2016 rksdna
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SHADOW_H
+#define SHADOW_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "device.h"
+
+#define SHADOW_PAGE_COUNT (DEVICE_MEMORY_SIZE / DEVICE_PAGE_SIZE)
+
+struct shadow
+{
+    uint8_t known[SHADOW_PAGE_COUNT];
+    uint8_t data[DEVICE_MEMORY_SIZE];
+};
+
+void clear_shadow(struct shadow *shadow);
+int load_shadow(struct shadow *shadow, const char *file);
+int save_shadow(const struct shadow *shadow, const char *file);
+void update_shadow(struct shadow *shadow, uint32_t address, const uint8_t *data, size_t size);
+void forget_shadow(struct shadow *shadow, uint32_t address, size_t size);
+int match_shadow(const struct shadow *shadow, uint32_t address, const uint8_t *data, size_t size);
+
+#endif
@@ -0,0 +1,311 @@
+/*
+ * Emrom - ROM emulator software
+ * Copyright (c) 2016 rksdna
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/stat.h>
+#include "../buffer.h"
+#include "../errors.h"
+
+#define WINDOW_SIZE 0x20000
+
+struct sample
+{
+    const char *text;
+    int result;
+    uint32_t origin;
+    size_t size;
+};
+
+static const struct sample samples[] =
+{
+    {":0400100001020304E2\n:00000001FF\n", DONE, 0x0010, 4},
+    {":0400100001020304e2\r\n\r\n:00000001FF\r\n", DONE, 0x0010, 4},
+    {":0400100001020304E2", DONE, 0x0010, 4},
+    {":020000040001F9\n:0100000055AA\n:00000001FF\n", DONE, 0x10000, 1},
+    {":020000021000EC\n:0100000055AA\n:00000001FF\n", DONE, 0x10000, 1},
+    {":0400000300001000E9\n:00000001FF\n", DONE, 0, 0},
+    {":0400000500010000F6\n:00000001FF\n", DONE, 0, 0},
+    {":00000001FF\n:0400100001020304E2\n", DONE, 0, 0},
+    {":0400100001020304E3\n", INVALID_FILE_CHECKSUM},
+    {":0400100001020304\n", INVALID_FILE_CONTENT},
+    {":0500100001020304E1\n", INVALID_FILE_CONTENT},
+    {":0400100001020304E2FF\n", INVALID_FILE_CONTENT},
+    {":04001000010203G4E2\n", INVALID_FILE_CONTENT},
+    {"0400100001020304E2\n", INVALID_FILE_CONTENT},
+    {":040010000102 304E2\n", INVALID_FILE_CONTENT},
+    {":0000\n", INVALID_FILE_CONTENT},
+    {":\n", INVALID_FILE_CONTENT},
+    {":01000001FFFF\n", INVALID_FILE_CONTENT},
+    {":0400000400010000F7\n", INVALID_FILE_CONTENT},
+    {":020000040002F8\n:0100000055AA\n", INVALID_FILE_CONTENT},
+    {":020000060001F7\n", INVALID_FILE_CONTENT}
+};
+
+static uint8_t data[WINDOW_SIZE];
+static uint8_t copy[WINDOW_SIZE];
+static int failures;
+
+static void fail(const char *name, const char *message)
+{
+    fprintf(stdout, "%s: %s\n", name, message);
+    failures++;
+}
+
+static int load_text(struct buffer *buffer, const char *text)
+{
+    int result;
+    FILE *stream = fmemopen((void *)text, strlen(text), "r");
+
+    if (!stream)
+        return INTERNAL_ERROR;
+
+    result = load_stream_buffer(buffer, stream);
+    fclose(stream);
+    return result;
+}
+
+static void check_samples(void)
+{
+    char line[1 + 2 * 265 + 1];
+    struct buffer buffer = {0, 0, WINDOW_SIZE, data};
+    int i;
+
+    memset(line, 'F', sizeof(line) - 1);
+    line[0] = ':';
+    line[sizeof(line) - 1] = 0;
+
+    if (load_text(&buffer, line) != INVALID_FILE_CONTENT)
+        fail("oversized record", "unexpected result");
+
+    for (i = 0; i < sizeof(samples) / sizeof(samples[0]); i++)
+    {
+        int result;
+
+        buffer.origin = 0;
+        buffer.size = WINDOW_SIZE;
+        buffer.data = data;
+        result = load_text(&buffer, samples[i].text);
+
+        if (result != samples[i].result)
+            fail(samples[i].text, "unexpected result");
+        else if (!result && (buffer.origin != samples[i].origin && samples[i].size || buffer.size != samples[i].size))
+            fail(samples[i].text, "unexpected range");
+    }
+}
+
+static void check_extract(void)
+{
+    static const char text[] = ":020000040800F2\n:0400100001020304E2\n:020000040000FA\n:0100000055AA\n:00000001FF\n";
+    struct buffer buffer = {0, 0x08000012, 0x100, data};
+    FILE *stream = fmemopen((void *)text, strlen(text), "r");
+
+    if (!stream || extract_stream_buffer(&buffer, stream))
+        fail("extract", "load failed");
+    else if (buffer.origin != 0x08000012 || buffer.size != 2 || data[0] != 0x03 || data[1] != 0x04)
+        fail("extract", "unexpected range");
+
+    if (stream)
+        fclose(stream);
+}
+
+static int count_record(void *context, uint32_t address, size_t size)
+{
+    size_t *total = context;
+
+    *total += size;
+    return address == 0x10 ? DONE : INVALID_FILE_CONTENT;
+}
+
+static void check_feed(void)
+{
+    static const char text[] = ":0400100001020304E2\n:0400100001020304E2\n:0100000055AA\n:00000001FF\n";
+    struct buffer buffer = {0, 0, WINDOW_SIZE, data};
+    FILE *stream = fmemopen((void *)text, strlen(text), "r");
+    size_t total = 0;
+
+    if (!stream || feed_stream_buffer(&buffer, stream, count_record, &total) != INVALID_FILE_CONTENT || total != 9)
+        fail("feed", "unexpected records");
+
+    if (stream)
+        fclose(stream);
+}
+
+static void check_fold(void)
+{
+    static uint8_t mask[WINDOW_SIZE];
+    struct buffer buffer = {0, 0, 0x10000, data, mask};
+
+    memset(mask, 0, sizeof(mask));
+    data[0xE010] = 0x5A;
+    mask[0xE010] = 1;
+    data[0x0011] = 0xA5;
+    mask[0x0011] = 1;
+
+    if (fold_buffer(&buffer, 0x2000) || buffer.size != 0x2000 || data[0x0010] != 0x5A || !mask[0x0010] || mask[0xE010])
+        fail("fold", "unexpected mirror");
+
+    buffer.size = 0x10000;
+    data[0x2011] = 0x00;
+    mask[0x2011] = 1;
+
+    if (fold_buffer(&buffer, 0x1000) != OVERLAPPING_FILE_CONTENT)
+        fail("fold", "differing mirrors accepted");
+}
+
+static void check_map(void)
+{
+    char file[] = "/tmp/emrom-test-XXXXXX";
+    char part[sizeof(file) + 8];
+    struct buffer buffer = {0, 0, 0x100};
+    struct buffer region;
+    struct stat status;
+    int fd = mkstemp(file);
+
+    if (fd < 0)
+    {
+        fail("map", "no temporary file");
+        return;
+    }
+
+    close(fd);
+    sprintf(part, "%s.part", file);
+
+    if (map_file_buffer(&buffer, file))
+    {
+        fail("map", "map failed");
+    }
+    else
+    {
+        memset(buffer.data, 0x5A, buffer.size);
+        region = buffer;
+        region.data = (uint8_t *)buffer.data + 0x10;
+        region.size = 0x20;
+
+        if (unmap_file_buffer(&buffer, &region, file) || stat(file, &status) || status.st_size != 0x20)
+            fail("map", "snapshot not kept");
+    }
+
+    if (map_file_buffer(&buffer, file))
+        fail("map", "map failed");
+    else if (unmap_file_buffer(&buffer, 0, file) || stat(file, &status) || status.st_size != 0x20 || !access(part, F_OK))
+        fail("map", "failed read replaced snapshot");
+
+    unlink(file);
+}
+
+static void check_round_trip(const char *name, const struct buffer *buffer)
+{
+    char file[] = "/tmp/emrom-test-XXXXXX";
+    struct buffer again = {0, 0, WINDOW_SIZE, copy};
+    int fd = mkstemp(file);
+
+    if (fd < 0)
+    {
+        fail(name, "no temporary file");
+        return;
+    }
+
+    close(fd);
+
+    if (save_file_buffer((struct buffer *)buffer, file))
+        fail(name, "save failed");
+    else if (load_file_buffer(&again, file))
+        fail(name, "saved file does not load");
+    else if (again.origin != buffer->origin || again.size != buffer->size || memcmp(again.data, buffer->data, buffer->size))
+        fail(name, "round trip changed content");
+
+    unlink(file);
+}
+
+static void check_generated(void)
+{
+    static const uint32_t origins[] = {0x00000, 0x00001, 0x0FFF0, 0x0FFFF, 0x1FF00};
+    static const size_t sizes[] = {1, 15, 16, 17, 0x100, 0x10000};
+    int i, j;
+    size_t k;
+
+    for (i = 0; i < sizeof(origins) / sizeof(origins[0]); i++)
+    {
+        for (j = 0; j < sizeof(sizes) / sizeof(sizes[0]); j++)
+        {
+            char name[64];
+            struct buffer buffer = {0, origins[i], sizes[j], data + origins[i]};
+
+            if (origins[i] + sizes[j] > WINDOW_SIZE)
+                continue;
+
+            for (k = 0; k < sizes[j]; k++)
+                data[origins[i] + k] = rand();
+
+            sprintf(name, "generated 0x%05X+0x%zX", origins[i], sizes[j]);
+            check_round_trip(name, &buffer);
+        }
+    }
+}
+
+static void check_corpus(const char *file)
+{
+    char path[4096];
+    struct buffer buffer = {0, 0, WINDOW_SIZE, data};
+    int result = load_file_buffer(&buffer, file);
+    int bad;
+
+    strncpy(path, file, sizeof(path) - 1);
+    bad = !strncmp(basename(path), "bad-", 4);
+
+    if (bad)
+    {
+        if (result != INVALID_FILE_CONTENT && result != INVALID_FILE_CHECKSUM)
+            fail(file, "malformed file accepted");
+    }
+    else if (result)
+    {
+        fail(file, "load failed");
+    }
+    else
+    {
+        check_round_trip(file, &buffer);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int i;
+
+    check_samples();
+    check_extract();
+    check_feed();
+    check_fold();
+    check_map();
+    check_generated();
+
+    for (i = 1; i < argc; i++)
+        check_corpus(argv[i]);
+
+    fprintf(stdout, "%d failures\n", failures);
+    return failures ? INTERNAL_ERROR : DONE;
+}
@@ -0,0 +1,162 @@
+/*
+ * Emrom - ROM emulator software
+ * Copyright (c) 2016 rksdna
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "../shadow.h"
+#include "../errors.h"
+
+#define IMAGE_SIZE 0x400
+#define TIMEOUT 500
+
+static uint8_t image[IMAGE_SIZE];
+static struct shadow shadow;
+static struct sim sim;
+
+static void check_hold(struct device *device)
+{
+    static const int holds[] = {100, 200, 500};
+
+    struct buffer buffer = {0, 0, IMAGE_SIZE, image};
+    struct stall stall;
+    int i;
+
+    for (i = 0; i < IMAGE_SIZE; i++)
+        image[i] = i * 7;
+
+    for (i = 0; i < sizeof(holds) / sizeof(holds[0]); i++)
+    {
+        if (set_device_hold(device, holds[i]) || write_device_memory(device, &buffer))
+        {
+            fail("hold", "write failed");
+            continue;
+        }
+
+        get_device_stall(device, &stall);
+
+        if (!stall.frames || stall.worst > holds[i] * 1e-6)
+            fail("hold", "verified frame stalls target longer than hold");
+    }
+
+    set_device_hold(device, 0);
+}
+
+static void check_scan(struct device *device)
+{
+    struct buffer buffer = {0, 0, IMAGE_SIZE, image};
+    struct stall stall;
+    uint32_t mismatch;
+
+    memset(image, 0xFF, IMAGE_SIZE);
+
+    if (write_device_memory(device, &buffer))
+        fail("scan", "write failed");
+
+    get_device_stall(device, &stall);
+
+    if (set_device_hold(device, 200) || check_device_memory(device, 0, IMAGE_SIZE, 0xFF, &mismatch) || verify_device_memory(device, &buffer))
+        fail("scan", "scan failed");
+
+    get_device_stall(device, &stall);
+
+    if (stall.frames < 2 || stall.worst > 200e-6)
+        fail("scan", "scan request stalls target longer than hold");
+
+    set_device_hold(device, 0);
+}
+
+static void check_plan(struct device *device, int features, const size_t *pages)
+{
+    struct buffer buffer = {0, 0, 4 * DEVICE_PAGE_SIZE, image};
+    struct settings settings;
+    struct cost plan;
+    struct cost naive;
+    int i;
+
+    for (i = 0; i < buffer.size; i++)
+        image[i] = rand();
+
+    memset(image + DEVICE_PAGE_SIZE, 0x00, DEVICE_PAGE_SIZE);
+    clear_shadow(&shadow);
+    update_shadow(&shadow, 0, image, DEVICE_PAGE_SIZE);
+    update_shadow(&shadow, 2 * DEVICE_PAGE_SIZE, image + 2 * DEVICE_PAGE_SIZE, DEVICE_PAGE_SIZE);
+    image[2 * DEVICE_PAGE_SIZE + 5] ^= 0xFF;
+
+    get_device_settings(device, &settings);
+    settings.identity.features = features;
+
+    memset(&plan, 0, sizeof(struct cost));
+    memset(&naive, 0, sizeof(struct cost));
+
+    if (set_device_settings(device, &settings))
+        fail("plan", "settings failed");
+
+    set_device_shadow(device, &shadow);
+    estimate_device_memory(device, &buffer, &plan, &naive);
+    set_device_shadow(device, 0);
+
+    for (i = 0; i < PLAN_COUNT; i++)
+    {
+        if (plan.pages[i] != pages[i])
+            fail("plan", "unexpected page plan");
+    }
+
+    if (naive.pages[PAGE_PLAN] != 4 || plan.time >= naive.time)
+        fail("plan", "plan is not cheaper than full pages");
+
+    settings.identity.features = sim.identity.features;
+    set_device_settings(device, &settings);
+}
+
+static void check_plans(struct device *device)
+{
+    static const size_t fill[PLAN_COUNT] = {[SKIP_PLAN] = 1, [FILL_PLAN] = 1, [PATCH_PLAN] = 1, [PAGE_PLAN] = 1};
+    static const size_t plain[PLAN_COUNT] = {[SKIP_PLAN] = 1, [PATCH_PLAN] = 1, [PAGE_PLAN] = 2};
+
+    check_plan(device, DEVICE_FILL_FEATURE, fill);
+    check_plan(device, 0, plain);
+}
+
+int main(int argc, char *argv[])
+{
+    struct identity identity;
+    struct device *device;
+
+    if (open_sim(&sim) || start_sim(&sim, 0))
+        return INTERNAL_ERROR;
+
+    if (!(device = create_device()) || open_device(device, sim.file) || set_device_timeout(device, TIMEOUT) || identify_device(device, &identity))
+        return INTERNAL_ERROR;
+
+    check_hold(device);
+    check_scan(device);
+    check_plans(device);
+
+    destroy_device(device);
+    close_sim(&sim);
+
+    fprintf(stdout, "%d failures\n", get_failures());
+    return get_failures() ? INTERNAL_ERROR : DONE;
+}
@@ -0,0 +1,124 @@
+/*
+ * Emrom - ROM emulator software
+ * Copyright (c) 2016 rksdna
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../buffer.h"
+#include "../errors.h"
+
+#define WINDOW_SIZE 0x20000
+
+static uint8_t data[WINDOW_SIZE];
+static uint8_t mask[WINDOW_SIZE];
+static uint8_t copy[WINDOW_SIZE];
+
+static void check(int condition, const char *message)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "%s\n", message);
+        abort();
+    }
+}
+
+static int load(struct buffer *buffer, const uint8_t *text, size_t size)
+{
+    int result;
+    FILE *stream = fmemopen((void *)text, size, "r");
+
+    check(stream != 0, "fmemopen failed");
+    result = load_stream_buffer(buffer, stream);
+    fclose(stream);
+    return result;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *text, size_t size)
+{
+    struct buffer buffer = {0, 0, WINDOW_SIZE, data, mask};
+    struct buffer again = {0, 0, WINDOW_SIZE, copy, 0};
+    char *saved = 0;
+    size_t length = 0;
+    FILE *stream;
+    size_t i;
+    int result;
+
+    if (!size)
+        return 0;
+
+    memset(data, 0, sizeof(data));
+    memset(mask, 0, sizeof(mask));
+
+    result = load(&buffer, text, size);
+    check(result == DONE || result == INVALID_FILE_CONTENT || result == INVALID_FILE_CHECKSUM, "unexpected load result");
+
+    if (result || !buffer.size)
+        return 0;
+
+    check(buffer.origin + buffer.size <= WINDOW_SIZE, "loaded range outside window");
+    check(buffer.mask[0] && buffer.mask[buffer.size - 1], "loaded range not tight");
+
+    for (i = 0; i < WINDOW_SIZE; i++)
+        check(!mask[i] || i >= buffer.origin && i < buffer.origin + buffer.size, "mask outside loaded range");
+
+    check((stream = open_memstream(&saved, &length)) != 0, "open_memstream failed");
+    check(save_stream_buffer(&buffer, stream) == DONE, "save failed");
+    fclose(stream);
+
+    memset(copy, 0, sizeof(copy));
+    check(load(&again, (uint8_t *)saved, length) == DONE, "saved file does not load");
+    check(again.origin == buffer.origin && again.size == buffer.size, "round trip changed range");
+    check(!memcmp(again.data, buffer.data, buffer.size), "round trip changed data");
+
+    free(saved);
+    return 0;
+}
+
+#ifndef FUZZ_ENGINE
+
+int main(int argc, char *argv[])
+{
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        FILE *stream = fopen(argv[i], "rb");
+        uint8_t *text;
+        long size;
+
+        if (!stream || fseek(stream, 0, SEEK_END) || (size = ftell(stream)) < 0 || fseek(stream, 0, SEEK_SET))
+            return INTERNAL_ERROR;
+
+        if (!(text = malloc(size + 1)) || fread(text, 1, size, stream) != size)
+            return INTERNAL_ERROR;
+
+        fclose(stream);
+        LLVMFuzzerTestOneInput(text, size);
+        free(text);
+    }
+
+    fprintf(stdout, "%d inputs replayed\n", argc - 1);
+    return DONE;
+}
+
+#endif
@@ -0,0 +1,100 @@
+/*
+ * Emrom - ROM emulator software
+ * Copyright (c) 2016 rksdna
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "../buffer.h"
+#include "../scramble.h"
+#include "../errors.h"
+
+#define IMAGE_SIZE 0x10000
+
+static const int data_lines[SCRAMBLE_DATA_LINES] = {7, 6, 5, 4, 3, 2, 1, 0};
+
+static uint8_t data[IMAGE_SIZE];
+static uint8_t wired[IMAGE_SIZE];
+static uint8_t copy[IMAGE_SIZE];
+static int failures;
+
+static void fail(const char *name, const char *message)
+{
+    fprintf(stdout, "%s: %s\n", name, message);
+    failures++;
+}
+
+static void swap_lines(int *address_lines)
+{
+    int i;
+
+    for (i = 0; i < SCRAMBLE_ADDRESS_LINES; i++)
+        address_lines[i] = i;
+
+    address_lines[0] = 15;
+    address_lines[15] = 0;
+}
+
+static void check_wiring(void)
+{
+    int address_lines[SCRAMBLE_ADDRESS_LINES];
+    struct scramble scramble;
+    struct buffer buffer = {0, 0, IMAGE_SIZE, data};
+    struct buffer target = {0, 0, IMAGE_SIZE, wired};
+    int i;
+
+    swap_lines(address_lines);
+
+    for (i = 0; i < IMAGE_SIZE; i++)
+        data[i] = i * 7 + (i >> 8);
+
+    data[0x0001] = 0x01;
+
+    if (init_scramble(&scramble, address_lines, data_lines) || scramble_buffer(&scramble, &buffer, &target, 0) || wired[0x8000] != 0x80)
+        fail("wiring", "unexpected wiring");
+
+    memset(copy, 0, IMAGE_SIZE);
+    buffer.data = copy;
+
+    if (scramble_buffer(&scramble, &target, &buffer, 1) || memcmp(copy, data, IMAGE_SIZE))
+        fail("wiring", "inverse does not restore image");
+}
+
+static void check_duplicate(void)
+{
+    int address_lines[SCRAMBLE_ADDRESS_LINES];
+    struct scramble scramble;
+
+    swap_lines(address_lines);
+    address_lines[1] = 15;
+
+    if (init_scramble(&scramble, address_lines, data_lines) != INVALID_OPTIONS_ARGUMENT)
+        fail("duplicate", "duplicate line accepted");
+}
+
+int main(int argc, char *argv[])
+{
+    check_wiring();
+    check_duplicate();
+
+    fprintf(stdout, "%d failures\n", failures);
+    return failures ? INTERNAL_ERROR : DONE;
+}
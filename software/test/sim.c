@@ -0,0 +1,364 @@
+/*
+ * Emrom - ROM emulator software
+ * Copyright (c) 2016 rksdna
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "sim.h"
+#include "../errors.h"
+
+static int failures;
+
+static int decode(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+
+    return -1;
+}
+
+static size_t span(const uint8_t *data)
+{
+    size_t size = data[2] | data[3] << 8;
+
+    return size ? size : DEVICE_MEMORY_SIZE;
+}
+
+static void reply(struct sim *sim, const uint8_t *data, size_t size)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    char frame[2 + 2 * (2 + DEVICE_PAGE_SIZE)];
+    char *p = frame;
+
+    *p++ = ':';
+
+    while (size--)
+    {
+        *p++ = digits[*data >> 4];
+        *p++ = digits[*data++ & 0x0F];
+    }
+
+    *p++ = '\n';
+
+    if (sim->send)
+        sim->send(sim->context, frame, p - frame);
+    else if (write(sim->fd, frame, p - frame) < 0)
+        exit(1);
+}
+
+static void identify(struct sim *sim)
+{
+    const struct identity *identity = &sim->identity;
+    uint8_t data[] =
+    {
+        identity->protocol, identity->frame, identity->commands,
+        (identity->memory >> 8) & 0xFF, (identity->memory >> 16) & 0xFF,
+        identity->queue, identity->features
+    };
+
+    reply(sim, data, identity->protocol >= DEVICE_FEATURE_PROTOCOL ? sizeof(data) : sizeof(data) - 1);
+}
+
+static void check(struct sim *sim, uint8_t *data)
+{
+    uint32_t address = data[0] | data[1] << 8;
+    size_t size = span(data);
+    size_t i;
+
+    for (i = 0; i < size && sim->memory[(address + i) & 0xFFFF] == data[4]; i++)
+        continue;
+
+    data[0] = i < size;
+    data[1] = (address + i) & 0xFF;
+    data[2] = ((address + i) >> 8) & 0xFF;
+    reply(sim, data, 3);
+}
+
+static void checksum(struct sim *sim, uint8_t *data)
+{
+    uint32_t address = data[0] | data[1] << 8;
+    uint32_t crc = data[4] | data[5] << 8 | data[6] << 16 | (uint32_t)data[7] << 24;
+    size_t size = span(data);
+    size_t i;
+    int bit;
+
+    for (i = 0; i < size; i++)
+    {
+        crc ^= sim->memory[(address + i) & 0xFFFF];
+
+        for (bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (crc & 1 ? 0xEDB88320 : 0);
+    }
+
+    data[0] = crc & 0xFF;
+    data[1] = (crc >> 8) & 0xFF;
+    data[2] = (crc >> 16) & 0xFF;
+    data[3] = crc >> 24;
+    reply(sim, data, 4);
+}
+
+static void read_page(struct sim *sim, uint8_t *data)
+{
+    uint32_t address = data[0] | data[1] << 8;
+    size_t i;
+
+    for (i = 0; i < DEVICE_PAGE_SIZE; i++)
+        data[2 + i] = sim->memory[(address + i) & 0xFFFF];
+
+    reply(sim, data, 2 + DEVICE_PAGE_SIZE);
+}
+
+static void sample(struct sim *sim, uint8_t *data)
+{
+    uint32_t address = data[0] | data[1] << 8;
+    size_t size = data[2];
+    size_t i;
+
+    if (!size || size > DEVICE_PAGE_SIZE)
+        return;
+
+    for (i = 0; i < size; i++)
+        data[i] = sim->memory[(address + i) & 0xFFFF];
+
+    reply(sim, data, size);
+}
+
+static void fill(struct sim *sim, uint8_t *data)
+{
+    uint32_t address = data[0] | data[1] << 8;
+    size_t size = span(data);
+    size_t i;
+
+    for (i = 0; i < size; i++)
+        sim->memory[(address + i) & 0xFFFF] = data[4];
+
+    data[0] = (address + size) & 0xFF;
+    data[1] = ((address + size) >> 8) & 0xFF;
+    reply(sim, data, 2);
+}
+
+static void write_page(struct sim *sim, uint8_t *data, size_t count, int verify)
+{
+    uint32_t address = data[0] | data[1] << 8;
+    uint8_t low = data[0];
+    uint8_t high = data[1];
+    size_t i;
+
+    for (i = 2; i < count; i++)
+    {
+        sim->memory[(address + i - 2) & 0xFFFF] = data[i];
+        low += data[i];
+        high += low;
+    }
+
+    if (verify)
+    {
+        data[0] = low;
+        data[1] = high;
+    }
+
+    reply(sim, data, 2);
+}
+
+static int answer(struct sim *sim, const char *line, size_t length)
+{
+    uint8_t data[2 + DEVICE_PAGE_SIZE];
+    size_t count = length / 2;
+    size_t i;
+
+    if (length && line[0] == '?')
+    {
+        identify(sim);
+        return 0;
+    }
+
+    if (!length || !strchr(":;=%&#", line[0]) || length % 2 == 0 || count > sizeof(data) || count < 2)
+        return 0;
+
+    for (i = 0; i < count; i++)
+    {
+        int high = decode(line[1 + 2 * i]);
+        int low = decode(line[2 + 2 * i]);
+
+        if (high < 0 || low < 0)
+            return 0;
+
+        data[i] = high << 4 | low;
+    }
+
+    switch (line[0])
+    {
+    case '=':
+        if (count == 5)
+            check(sim, data);
+        return 0;
+
+    case '%':
+        if (count == 8)
+            checksum(sim, data);
+        return 0;
+
+    case '&':
+        if (count == 3)
+            sample(sim, data);
+        return 0;
+
+    case '#':
+        if (count == 5)
+            fill(sim, data);
+        return 0;
+
+    case ';':
+        if (count == 2)
+            return 0;
+        write_page(sim, data, count, 1);
+        return 1;
+
+    default:
+        if (count == 2)
+        {
+            read_page(sim, data);
+            return 0;
+        }
+        write_page(sim, data, count, 0);
+        return 1;
+    }
+}
+
+int open_sim(struct sim *sim)
+{
+    static const struct identity identity = {3, DEVICE_PAGE_SIZE, 0xFF, DEVICE_MEMORY_SIZE, 1, DEVICE_FILL_FEATURE};
+    struct termios options;
+
+    memset(sim, 0, sizeof(struct sim));
+    sim->identity = identity;
+    sim->hold = -1;
+
+    if ((sim->memory = mmap(0, DEVICE_MEMORY_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+        return INTERNAL_ERROR;
+
+    memset(sim->memory, 0xFF, DEVICE_MEMORY_SIZE);
+
+    if ((sim->fd = posix_openpt(O_RDWR | O_NOCTTY)) < 0 || grantpt(sim->fd) || unlockpt(sim->fd))
+        return INTERNAL_ERROR;
+
+    tcgetattr(sim->fd, &options);
+    cfmakeraw(&options);
+    tcsetattr(sim->fd, TCSANOW, &options);
+    sim->file = ptsname(sim->fd);
+
+    if ((sim->hold = open(sim->file, O_RDWR | O_NOCTTY)) < 0)
+        return INTERNAL_ERROR;
+
+    return DONE;
+}
+
+void close_sim(struct sim *sim)
+{
+    if (sim->pid > 0)
+    {
+        kill(sim->pid, SIGTERM);
+        waitpid(sim->pid, 0, 0);
+    }
+
+    if (sim->hold >= 0)
+        close(sim->hold);
+
+    close(sim->fd);
+    munmap(sim->memory, DEVICE_MEMORY_SIZE);
+}
+
+int start_sim(struct sim *sim, void (*run)(struct sim *sim))
+{
+    char data[4096];
+    ssize_t size;
+
+    if ((sim->pid = fork()) < 0)
+        return INTERNAL_ERROR;
+
+    if (sim->pid)
+        return DONE;
+
+    if (run)
+        run(sim);
+
+    while ((size = read(sim->fd, data, sizeof(data))) > 0)
+        feed_sim(sim, data, size);
+
+    exit(0);
+}
+
+int feed_sim(struct sim *sim, const char *data, size_t size)
+{
+    int writes = 0;
+
+    while (size--)
+    {
+        char c = *data++;
+
+        if (c != '\n')
+        {
+            if (sim->length < sizeof(sim->line))
+                sim->line[sim->length++] = c;
+
+            continue;
+        }
+
+        if (sim->length < sizeof(sim->line))
+            writes += answer(sim, sim->line, sim->length);
+
+        sim->length = 0;
+    }
+
+    return writes;
+}
+
+double get_time(void)
+{
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+void fail(const char *name, const char *message)
+{
+    fprintf(stdout, "%s: %s\n", name, message);
+    failures++;
+}
+
+int get_failures(void)
+{
+    return failures;
+}
@@ -0,0 +1,56 @@
+/*
+ * Emrom - ROM emulator software
+ * Copyright (c) 2016 rksdna
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "../device.h"
+
+#define SIM_LINE_SIZE (2 * (2 + DEVICE_PAGE_SIZE) + 8)
+
+struct sim
+{
+    const char *file;
+    int fd;
+    int hold;
+    pid_t pid;
+    struct identity identity;
+    uint8_t *memory;
+    void (*send)(void *context, const char *data, size_t size);
+    void *context;
+    char line[SIM_LINE_SIZE];
+    size_t length;
+};
+
+int open_sim(struct sim *sim);
+void close_sim(struct sim *sim);
+int start_sim(struct sim *sim, void (*run)(struct sim *sim));
+int feed_sim(struct sim *sim, const char *data, size_t size);
+double get_time(void);
+void fail(const char *name, const char *message);
+int get_failures(void);
+
+#endif
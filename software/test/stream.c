@@ -0,0 +1,197 @@
+/*
+ * Emrom - ROM emulator software
+ * Copyright (c) 2016 rksdna
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "sim.h"
+#include "../errors.h"
+
+#define PAGE_COUNT 4
+#define RECORD_SIZE 0x10
+#define DELAY 2.0
+
+static struct sim sim;
+
+static int serve(double until, int *writes)
+{
+    struct pollfd poller = {sim.fd, POLLIN, 0};
+    int start = *writes;
+
+    while (get_time() < until)
+    {
+        char data[256];
+        ssize_t size;
+
+        if (poll(&poller, 1, 10) <= 0)
+            continue;
+
+        if ((size = read(sim.fd, data, sizeof(data))) <= 0)
+            return 0;
+
+        *writes += feed_sim(&sim, data, size);
+
+        if (*writes > start)
+            return 1;
+    }
+
+    return 0;
+}
+
+static pid_t start_loader(int *input, const char *rom)
+{
+    int fds[2];
+    pid_t pid;
+
+    if (pipe(fds))
+        return -1;
+
+    if ((pid = fork()) == 0)
+    {
+        dup2(fds[0], STDIN_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+
+        if (!freopen("/dev/null", "w", stdout))
+            exit(INTERNAL_ERROR);
+
+        unsetenv("HOME");
+        execl("./emrom", "emrom", "-c", sim.file, "-R", rom, "-w", "-", "-d", (char *)0);
+        exit(INTERNAL_ERROR);
+    }
+
+    close(fds[0]);
+    *input = fds[1];
+    return pid;
+}
+
+static int finish_loader(pid_t pid, int *writes)
+{
+    int status;
+
+    while (waitpid(pid, &status, WNOHANG) == 0)
+        serve(get_time() + 0.1, writes);
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : INTERNAL_ERROR;
+}
+
+static void put_record(int fd, uint16_t address, uint8_t value)
+{
+    char line[1 + 2 * (RECORD_SIZE + 5) + 1];
+    uint8_t checksum = -(RECORD_SIZE + (address >> 8) + address + RECORD_SIZE * value);
+    int length = sprintf(line, ":%.2X%.4X00", RECORD_SIZE, address);
+    int i;
+
+    for (i = 0; i < RECORD_SIZE; i++)
+        length += sprintf(line + length, "%.2X", value);
+
+    length += sprintf(line + length, "%.2X\n", checksum);
+
+    if (write(fd, line, length) != length)
+        fail("fold", "producer failed");
+}
+
+static void check_pipe(void)
+{
+    uint8_t page[DEVICE_PAGE_SIZE];
+    int writes = 0;
+    int input;
+    pid_t pid;
+    int i;
+
+    if ((pid = start_loader(&input, "device")) < 0)
+    {
+        fail("pipe", "no loader");
+        return;
+    }
+
+    memset(page, 0x55, sizeof(page));
+
+    if (write(input, page, sizeof(page)) != sizeof(page))
+        fail("pipe", "producer failed");
+
+    if (!serve(get_time() + DELAY, &writes))
+        fail("pipe", "first page not sent while producer is still writing");
+
+    for (i = 1; i < PAGE_COUNT; i++)
+    {
+        if (write(input, page, sizeof(page)) != sizeof(page))
+            fail("pipe", "producer failed");
+    }
+
+    close(input);
+
+    if (finish_loader(pid, &writes) != DONE)
+        fail("pipe", "write failed");
+
+    if (writes != PAGE_COUNT)
+        fail("pipe", "pages lost");
+}
+
+static void check_fold(uint16_t mirror, int expected)
+{
+    int writes = 0;
+    int input;
+    pid_t pid;
+    int i;
+
+    memset(sim.memory, 0xFF, DEVICE_MEMORY_SIZE);
+
+    if ((pid = start_loader(&input, "2764")) < 0)
+    {
+        fail("fold", "no loader");
+        return;
+    }
+
+    for (i = 0; i < DEVICE_PAGE_SIZE; i += RECORD_SIZE)
+        put_record(input, 0xE000 + i, 0xAA);
+
+    put_record(input, mirror, 0x55);
+    close(input);
+
+    if (finish_loader(pid, &writes) != expected)
+        fail("fold", "unexpected loader result");
+
+    if (expected == DONE && (sim.memory[0x0000] != 0xAA || sim.memory[mirror & 0x1FFF] != 0x55 || sim.memory[0xE000] != 0xFF))
+        fail("fold", "records above ROM size not folded");
+}
+
+int main(int argc, char *argv[])
+{
+    if (open_sim(&sim))
+        return INTERNAL_ERROR;
+
+    sim.identity.protocol = 1;
+    sim.identity.commands = DEVICE_READ_COMMAND | DEVICE_WRITE_COMMAND | DEVICE_PATCH_COMMAND | DEVICE_IDENTIFY_COMMAND;
+
+    check_pipe();
+    check_fold(0xE040, DONE);
+    check_fold(0x0000, OVERLAPPING_FILE_CONTENT);
+    close_sim(&sim);
+
+    fprintf(stdout, "%d failures\n", get_failures());
+    return get_failures() ? INTERNAL_ERROR : DONE;
+}